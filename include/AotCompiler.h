@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "CPU.h"
+
+/*
+Ahead-of-time compiler
+Turns the program booted into a CPU into C++ source. Code is found by following control flow from
+the boot address (and from any interrupt handlers set with INT), and each basic block becomes a
+native function. The common integer instructions (SET, ADD, INC, DEC, FLIP, ABS, SWAP, READ and
+WRITE on Tryte and Trint registers), CMP and the jumps are written out as C++ that works on the
+registers directly; every other instruction is a direct call to the operation its handler runs,
+with its operands resolved. The functions belong to a specialisation of AotProgram (a friend of
+CPU), and register themselves with the CPU before main runs; link the output with the computer's
+objects to get a computer with the program built in.
+Anything not found statically (returns, threads, FPU code, code written at run time) is left to
+the interpreter, as is any block whose instructions have changed in memory.
+*/
+class AotCompiler
+{
+private:
+	// an instruction in a compiled block
+	struct Op
+	{
+		int16_t addr;
+		int16_t instr;
+		// address execution continues from if the instruction doesn't jump
+		int16_t next;
+	};
+
+	// how a handler passes an instruction's operands to the operation it runs
+	enum class Operands { none, tryte, tryte_pair, trint, trint_pair, number, size };
+	// a handler, and the operation compiled code calls in its place
+	struct Call
+	{
+		void (*handler)(CPU& cpu, CPU::DecodedInstr const& decoded);
+		Operands operands;
+		char const* op;
+	};
+
+	CPU& _cpu;
+	// compiled blocks, by start address
+	std::map<int16_t, std::vector<Op>> _blocks;
+	// start addresses still to compile
+	std::vector<int16_t> _pending;
+
+	// queue a block to compile, if it hasn't been already
+	void add_entry(int64_t addr);
+	// compile the block starting at addr, queuing the blocks it can lead to
+	void compile_block(int16_t addr);
+	void write_block(std::ostream& out, int16_t addr, std::vector<Op> const& block) const;
+	// write an instruction as C++ that runs it inline, if it can be (false if not)
+	bool write_inline(std::ostream& out, Op const& op, CPU::DecodedInstr const& decoded) const;
+	// write a direct call to the operation an instruction's handler runs, if it is known (false if
+	// not). instr is the C++ for the instruction, which the CPU is set to first.
+	bool write_call(std::ostream& out, CPU::DecodedInstr const& decoded, std::string const& instr) const;
+	// every handler write_call knows
+	static std::vector<Call> const& calls();
+	// C++ for a register operand, and for the Tryte (or Trint) at a fixed address
+	std::string tryte_reg(Tryte const* reg) const;
+	std::string trint_reg(Trint<3> const* reg) const;
+	static std::string memory_at(int64_t addr);
+	static std::string trint_at(int64_t addr);
+
+public:
+	// cpu should be booted, with the program in memory
+	AotCompiler(CPU& cpu);
+
+	// find and compile every reachable block
+	void compile();
+	// number of blocks compiled
+	size_t size() const;
+	// write the compiled program as C++
+	void write(std::ostream& out) const;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+Batch runner
+Runs many independent programs in one process, each on its own computer, spread over a
+work-stealing thread pool. The jobs are listed in a manifest, one per line:
+disk0.tri [disk1.tri ...] [< input.txt] [> output.txt]
+The disks are mounted as for a single run, with the first as the boot disk. Console input is read
+from the input file (none given - every read gives 0), and console output is collected in memory and
+written to the output file when the job finishes (default: the boot disk's name with .out in place
+of .tri). Blank lines and lines starting with # are ignored.
+Jobs run at the same time, so they shouldn't share any disk they SAVE to.
+*/
+class BatchRunner
+{
+public:
+	struct Job
+	{
+		std::vector<std::string> disk_filenames;
+		std::string input_filename;
+		std::string output_filename;
+	};
+	struct Result
+	{
+		bool ok;
+		// what went wrong, if not ok
+		std::string error;
+		// instructions executed, and host time taken
+		size_t instructions;
+		uint64_t us;
+	};
+
+private:
+	std::vector<Job> _jobs;
+	std::vector<Result> _results;
+	bool _jit;
+
+	// parse one line of the manifest - returns false for blank lines and comments
+	static bool parse_job(std::string const& text, Job& job);
+	// run job n, filling in its result. Never throws.
+	void run_job(size_t n);
+
+public:
+	// read the jobs in a manifest
+	BatchRunner(std::string const& manifest_filename);
+
+	// compile hot code in every job to native code (see CPU::enable_jit)
+	void enable_jit();
+	// run every job on thread_count threads (0 - one per hardware thread); returns the number that failed
+	size_t run(size_t thread_count = 0);
+
+	size_t size() const;
+	Job const& job(size_t n) const;
+	Result const& result(size_t n) const;
+};
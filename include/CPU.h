@@ -1,48 +1,102 @@
 #pragma once
 #include <string>
-#include <map>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <exception>
 #include "Memory.h"
+#include "DiskManager.h"
+#include "Jit.h"
 #include "Trint.h"
 #include "Console.h"
 #include "FPU.h"
+#include "Flags.h"
+#include "Profiler.h"
+#include "ReplayLog.h"
+#include "Display.h"
+
+// code generated by AotCompiler - each compiled program specialises it for a type of its own
+template <typename Program>
+struct AotProgram;
 
 class CPU
 {
+	// reads the decoder, to compile programs ahead of time
+	friend class AotCompiler;
+	// works on the CPU directly, as the interpreter's handlers do
+	template <typename Program>
+	friend struct AotProgram;
+	// reads the block cache and registers, to compile hot blocks
+	friend class JitCompiler;
+
+public:
+	// a block of guest code compiled ahead of time. Returns false, without running anything, if the
+	// code in memory has changed since it was compiled - the interpreter runs it instead.
+	typedef bool (*AotBlock)(CPU& cpu);
+	struct AotBlockEntry
+	{
+		int16_t addr;
+		AotBlock block;
+	};
+
+	// most cores one computer can have - each core's stack gets a 729 Tryte slice of the lower
+	// half of memory
+	static size_t const max_cores = 13;
+
 private:
-	// reference to main memory
-	Memory<19683> _memory;
+	// devices shared by every core of a computer, and a lock held while any core uses them
+	struct Devices
+	{
+		// disks, opened once when the computer is switched on
+		DiskManager disks;
+		Console console;
+		std::mutex mutex;
+		// graphics device, started the first time graphics mode is set (see Display.h). After the
+		// console and mutex, which it uses until it is destroyed.
+		unsigned frame_rate = Display::default_frame_rate;
+		std::unique_ptr<Display> display;
 
-	// disk filenames
-	std::vector<std::string> _disknames;
+		Devices(std::vector<std::string> const& disk_names) : disks(disk_names) {}
+	};
 
-	// console
-	Console _console;
+	// reference to main memory (shared by every core)
+	Memory<19683>& _memory;
+	std::shared_ptr<Devices> _devices;
+	DiskManager& _disks;
+	Console& _console;
+
+	// number of this core (0 for the boot core)
+	int16_t _core;
 
 	// clock ticks (for timer)
 	size_t _clock;
 
-	// on/off switch
-	bool _on;
-
-	// registers
-	Trint<3> _a;
-	Trint<3> _b;
-	Trint<3> _c;
-	Trint<3> _d;
-	Trint<3> _e;
-	Trint<3> _g;
-	Trint<3> _h;
-	Trint<3> _i;
-	Trint<3> _j;
-
-	// register IDs 
-	std::map<char, Tryte*> tryte_regs = { {'M', &_a[0]}, {'L', &_a[1]}, {'K', &_a[2]},
-		{'J', &_b[0]}, {'I', &_b[1]}, {'H', &_b[2]}, {'G', &_c[0]}, {'F', &_c[1]}, {'E', &_c[2]},
-		{'D', &_d[0]}, {'C', &_d[1]}, {'B', &_d[2]}, {'A', &_e[0]}, {'0', &_e[1]}, {'a', &_e[2]},
-		{'b', &_g[0]}, {'c', &_g[1]}, {'d', &_g[2]}, {'e', &_h[0]}, {'f', &_h[1]}, {'g', &_h[2]},
-		{'h', &_i[0]}, {'i', &_i[1]}, {'j', &_i[2]}, {'k', &_j[0]}, {'l', &_j[1]}, {'m', &_j[2]}};
-
-	std::array<Trint<3>*, 9> trint_regs = { &_a, &_b, &_c, &_d, &_e, &_g, &_h, &_i, &_j };
+	// on/off switch (atomic, as the host may switch off a CPU blocked in WAIT from another thread)
+	std::atomic<bool> _on;
+
+	// interrupt raised by the host with set_interrupt_priority, possibly from another thread.
+	// It is merged into the stored priority in _flags at CHK, WAIT and dump.
+	std::mutex _interrupt_mutex;
+	std::condition_variable _interrupt_signal;
+	std::atomic<bool> _interrupt_pending;
+	int16_t _pending_priority;
+	// virtual clock ticks for each microsecond spent blocked in WAIT - roughly the rate
+	// the interpreter runs instructions, so the clock moves at about the same speed either way
+	static size_t const _wait_ticks_per_us = 10;
+
+	// background console input (only if enable_async_input has been called). Declared after the
+	// interrupt members, as its thread raises interrupts until it is destroyed.
+	std::unique_ptr<InputDevice> _input;
+	// everything taken in from outside, if recording or replaying (see ReplayLog). When replaying,
+	// interrupts and console input come from the log alone, and WAIT doesn't sleep.
+	std::unique_ptr<ReplayLog> _log;
+
+	// register file - the Trint registers a, b, c, d, e, g, h, i, j side by side, so all 27 Trytes
+	// share one cache line. Tryte registers M to m are the Trytes in order (M, L, K are a).
+	alignas(64) std::array<Trint<3>, 9> _regs;
+	static_assert(sizeof(Trint<3>) == 3 * sizeof(Tryte), "Trint registers must be three packed Trytes");
 
 	// instruction pointer
 	Tryte _i_ptr;
@@ -53,24 +107,145 @@ private:
 	// interrupt pointer array
 	std::array<Tryte, 27> _int_ptrs;
 
-	// current disk
-	int16_t _disk_num;
-
 	// current instruction
 	Tryte _instr;
 
-	// flags (for interrupts, logical results of calcs, etc)
-	// layout:
-	// stored_interrupt (3 trits) | current_interrupt (3 trits) | overflow | carry | compare
-	Tryte _flags;
+	// flags (for interrupts, logical results of calcs, etc), unpacked - see Flags.h
+	Flags _flags;
 
 	// float processing unit (contains float registers)
-	FPU _FPU = FPU(_memory, _console, _flags, _i_ptr, _s_ptr);
+	FPU _FPU = FPU(_memory, _console, _devices->mutex, _flags, _i_ptr, _s_ptr);
+
+	// an instruction decoded ahead of time - handler plus its resolved operands
+	struct DecodedInstr
+	{
+		// function that executes the instruction
+		void (*handler)(CPU& cpu, DecodedInstr const& decoded);
+		// Tryte register operands (nullptr if unused)
+		Tryte* x;
+		Tryte* y;
+		// Trint register operands (nullptr if unused)
+		Trint<3>* trint_x;
+		Trint<3>* trint_y;
+		// small constant encoded in the instruction itself (THD n, PRI n, INT n, MNT n, DSET n)
+		int16_t n;
+		// length of the instruction in Trytes, including operands (0 if only the FPU knows)
+		int16_t length;
+		// the raw instruction (the FPU does its own decoding)
+		Tryte instr;
+		// true if the instruction can jump or write to memory (last instruction of a cached block)
+		bool ends_block;
+	};
+
+	// an instruction inside a cached block
+	struct BlockOp
+	{
+		DecodedInstr const* decoded;
+		// the instruction the op was decoded from (checked against memory on block entry)
+		Tryte instr;
+		// address of the instruction
+		Tryte addr;
+		// address execution continues from if the instruction doesn't jump
+		Tryte next;
+		// set on a compare followed by JPZ, JPN or JPP (the last op of the block): runs both
+		// instructions at once, so the block's loop-control branch is a single op
+		void (*fused)(CPU& cpu, DecodedInstr const& decoded);
+	};
+
+	// decode table - one entry per possible instruction Tryte, indexed by value + 9841
+	std::vector<DecodedInstr> _decode_table;
+
+	// block cache - straight-line runs of decoded instructions, indexed by start address + 9841
+	std::vector<std::vector<BlockOp>> _block_cache;
+	// longest run of instructions stored in one block
+	static size_t const _max_block_size = 256;
+
+	// JIT tier (only if enable_jit has been called) - cached blocks that run _jit_threshold times
+	// are compiled to native code
+	struct JitBlock
+	{
+		// times the block has run since it was recorded
+		size_t executions;
+		// compiled block (nullptr until it gets hot)
+		Jit::Code code;
+	};
+	std::unique_ptr<Jit> _jit;
+	std::vector<JitBlock> _jit_blocks;
+	// exception thrown by a handler called from compiled code, which it can't unwind through -
+	// caught by jit_call, and thrown again by run_block once the compiled code has returned
+	std::exception_ptr _jit_exception;
+	static size_t const _jit_threshold = 32;
+	static size_t const _jit_arena_size = 4 << 20;
+
+	// execution profile (only if enable_profiler has been called)
+	std::unique_ptr<Profiler> _profiler;
+	std::ostream* _profile_output;
+
+	// blocks compiled ahead of time and linked into the program (see AotCompiler), indexed by
+	// start address + 9841. Empty unless some were registered.
+	std::vector<AotBlock> _aot_blocks;
+	// every block registered so far, by any compiled program linked in
+	static std::vector<AotBlockEntry>& aot_registry();
 
 	// fetch the Tryte at the instruction pointer and set it as current instruction
 	void fetch();
 	// decode the current instruction and execute it
 	void decode_and_execute();
+	// set up the decode table (called once, from the constructor). Entries are decoded the
+	// first time they are executed, so booting doesn't pay for all 19,683 up front.
+	void build_decode_table();
+	// execute the cached block at the instruction pointer (or record one, if there isn't a valid one)
+	void run_block();
+	// run one instruction at a time, timing each one for the profiler, until the CPU stops
+	void run_profiled();
+	// execute instructions one by one, storing them in a block until one of them ends the block
+	void record_block(std::vector<BlockOp>& block);
+	// check a cached block still matches the instructions in memory
+	bool block_is_valid(std::vector<BlockOp> const& block);
+	// compile a cached block to native code (nullptr if it can't be)
+	Jit::Code compile_block(std::vector<BlockOp> const& block);
+	// run a block op's handler (or fused handler) for compiled code, catching any exception and
+	// switching the CPU off, so the compiled code returns
+	static void jit_call(CPU& cpu, BlockOp const& op);
+	// fuse the compare and conditional jump at the end of a block, if it ends with them
+	void fuse_block(std::vector<BlockOp>& block);
+	// decode a single instruction into a handler and its operands
+	DecodedInstr decode(Tryte const& instr);
+	// Tryte register with the given septavingt digit (-13 for M, up to 13 for m)
+	Tryte* tryte_reg(int16_t digit);
+	// Trint register n (0 for a, up to 8 for j)
+	Trint<3>* trint_reg(int16_t n);
+	// set the overflow flag (used when a division fails)
+	void set_overflow();
+	// -1, 0 or 1 as x is less than, equal to or greater than y
+	template <typename T>
+	static int16_t compare_sign(T const& x, T const& y);
+	// the comparison made by a decoded CMP instruction at the instruction pointer
+	int16_t compare_sign(DecodedInstr const& decoded);
+	// move a pending host interrupt into the stored priority in _flags
+	void take_pending_interrupt();
+	// handle the stored interrupt: clear it (so it is only handled once) and switch to its thread
+	void enter_interrupt(int16_t priority);
+
+	// handlers stored in the decode table, one for each shape of operation
+	template <void (CPU::*op)()>
+	static void handle(CPU& cpu, DecodedInstr const& decoded);
+	template <void (CPU::*op)(Tryte&)>
+	static void handle_tryte(CPU& cpu, DecodedInstr const& decoded);
+	template <void (CPU::*op)(Tryte&, Tryte&)>
+	static void handle_tryte_pair(CPU& cpu, DecodedInstr const& decoded);
+	template <void (CPU::*op)(Trint<3>&)>
+	static void handle_trint(CPU& cpu, DecodedInstr const& decoded);
+	template <void (CPU::*op)(Trint<3>&, Trint<3>&)>
+	static void handle_trint_pair(CPU& cpu, DecodedInstr const& decoded);
+	template <typename N, void (CPU::*op)(N)>
+	static void handle_num(CPU& cpu, DecodedInstr const& decoded);
+	static void handle_float(CPU& cpu, DecodedInstr const& decoded);
+	// fused handler for a CMP (decoded) followed by a conditional jump, taken if the comparison is taken_sign
+	template <int16_t taken_sign>
+	static void handle_compare_and_jump(CPU& cpu, DecodedInstr const& decoded);
+	// handler of decode table entries that haven't been decoded yet - decodes the entry, then runs it
+	static void handle_undecoded(CPU& cpu, DecodedInstr const& decoded);
 
 	/*
 	OPERATIONS
@@ -119,6 +294,8 @@ private:
 	void set_display_mode(Tryte& a);
 	void set_display_mode(Trint<3>& a);
 	void set_display_mode(size_t n);
+	// switch the console to graphics, starting the display if it isn't running (device lock held)
+	void graphics_mode();
 	// DGET A
 	// Get the display mode and put it in register A.
 	void get_display_mode(Tryte& a);
@@ -333,26 +510,185 @@ private:
 	// Pop from stack, and go to that location in memory
 	void pop_and_jump();
 	// THD n
-	// Jump execution to the nth thread (_i_ptr goes to _int_ptrs[n])
-	void switch_thread(size_t n);
+	// Jump execution to the nth thread (_i_ptr goes to _int_ptrs[n + 13], as -13 <= n <= 13)
+	void switch_thread(int16_t n);
 	// INT n, $X
-	void set_interrupt_ptr(size_t n);
+	void set_interrupt_ptr(int16_t n);
 	// HALT
 	// Stop the CPU. CPU will have to be turned on from outside.
 	void halt_and_catch_fire();
 	// WAIT
 	// do nothing but compare interrupts. Useful while waiting for input.
+	// Blocks until an interrupt arrives, rather than spinning.
 	void wait();
 
+	/*
+	multi-core
+	Every core runs on its own host thread, with its own registers, flags, threads and stack, over
+	the same memory. The memory model:
+	- a core sees its own reads and writes in program order
+	- other cores may see a core's plain reads and writes (READ, WRITE, PUSH, SET $X and so on)
+	  late and in any order, but a single Tryte is never torn (a Trint or float can be). Plain
+	  accesses are relaxed atomics (Memory::load and store), so this holds in C++ on any target,
+	  and the JIT's plain moves are the same accesses on x86-64.
+	- CAS and FADD are atomic, and sequentially consistent: all cores see all of them in one order
+	- FENCE (and CAS and FADD) make every access before it visible to all cores before any after it
+	So data written with plain writes is safely handed to another core by a FENCE (or CAS/FADD)
+	on the writing core, followed by the other core seeing the flag with CAS/FADD or after a FENCE.
+	Code written by one core is picked up by another the next time it jumps there.
+	Devices (disks and console) are shared, and used by one core at a time.
+	*/
+	// CORE X
+	// Put the number of this core in Tryte register X.
+	void get_core(Tryte& x);
+	// CAS X, Y, $Z
+	// Atomically: if the Tryte at address Z equals X, write Y there and set the compare flag to 0;
+	// otherwise load it into X and set the compare flag to + if it was greater than X, - if less.
+	void compare_and_swap(Tryte& x, Tryte& y);
+	// FADD X, $Y
+	// Atomically add X to the Tryte at address Y, and put the Tryte that was there in X.
+	void fetch_add(Tryte& x);
+	// FENCE
+	// Make every memory access before the fence visible to all cores before any after it.
+	void fence();
+
+	// set everything up for a core (called from the constructors)
+	void reset();
+
 
 public:
 	CPU(Memory<19683>& memory, std::vector<std::string>& disk_names);
-	void boot();
+	// core number core (1 to max_cores - 1) of the computer boot_core belongs to. It shares the
+	// memory, disks and console, and starts at address 0 like the boot core; its stack starts
+	// 729 * core Trytes after the boot core's.
+	CPU(CPU& boot_core, int16_t core);
+	// boot core: copy the boot disk into memory and switch on; returns the number of Trytes loaded.
+	// Other cores just switch on (and return 0).
+	size_t boot();
 	void run();
+	// run one instruction at a time until the instruction pointer reaches addr (or the CPU stops)
+	void run_until(Tryte const& addr);
 	void step();
+	// switch back on after a HALT, carrying on from the instruction after it
+	void resume();
 	void switch_off();
 	bool is_on();
+	// number of instructions executed so far
+	size_t clock() const;
 	void current_instr();
 	void dump();
+	// raise an interrupt with priority n. Safe to call from any thread; wakes the CPU if it is in WAIT.
 	void set_interrupt_priority(int16_t n);
-};
\ No newline at end of file
+	// read console input on a background thread, raising an interrupt with priority n whenever
+	// input arrives. TELL then never blocks - it reads zeroes if no input is waiting.
+	void enable_async_input(int16_t n);
+	// compile hot blocks to native code (x86-64 only)
+	void enable_jit();
+	// profile execution, writing a report to profile_output when the CPU stops.
+	// Instructions then run one at a time - the JIT and compiled code aren't used.
+	// With a source map (see SourceMap.h), the report also covers functions and source lines.
+	void enable_profiler(std::ostream& profile_output, std::string const& map_filename = "");
+	// send console output to, and read console input from, other streams than std::cout and std::cin
+	void redirect_console(std::ostream& output, std::istream& input);
+	// stop the display's frame thread (if graphics mode has started it), or start it again. Nothing
+	// but the cores uses the devices while it is stopped, so the computer can be forked.
+	void pause_display();
+	void resume_display();
+	// console output is buffered (see Console.h) - set the buffer's size, or write it out now
+	void set_console_buffer_size(size_t bytes);
+	void flush_console();
+	// frames drawn per second in graphics mode (0 - only when the computer halts). Set before
+	// the program starts.
+	void set_frame_rate(unsigned frame_rate);
+	// record console input, interrupts and time asleep in WAIT to a replay log; or replay a log
+	// recorded earlier, so the program takes in exactly what it did then, at the same clock. Single
+	// core only - other cores change the order things happen in.
+	void record_input(std::string const& filename);
+	void replay_input(std::string const& filename);
+	// true if a replayed log still has events the program hasn't asked for
+	bool replay_unfinished() const;
+
+	/*
+	snapshots
+	The complete state of a single-core computer, in a binary file: an 8 byte header ("TRISNAP"
+	followed by a version byte), then int16_t values in the host's byte order - memory (19,683 Trytes), the
+	27 Tryte registers, the instruction pointer, stack pointer, current instruction, the 27 thread
+	pointers, the flags (stored and current priority, overflow, carry, compare), the mounted disk,
+	the console mode and the 9 float registers (3 Trytes each) - and finally the clock, as a
+	uint64_t. So a snapshot can only be restored on a host with the same byte order.
+	*/
+	static std::string const snapshot_header;
+	// save the computer's state
+	void save_snapshot(std::string const& filename);
+	// restore a saved state and switch on, instead of booting. The computer should have the disks
+	// it had when the snapshot was saved; they aren't part of the snapshot.
+	void restore_snapshot(std::string const& filename);
+
+	/*
+	runtime for code compiled ahead of time
+	*/
+	// add compiled blocks - called by the generated code, before main runs
+	static bool register_aot_blocks(AotBlockEntry const* blocks, size_t count);
+	// true if the instructions at the given addresses are still the ones compiled
+	bool aot_code_matches(int16_t const* addrs, int16_t const* instrs, size_t count);
+	// execute one compiled instruction, as run_block does. Returns true if execution falls
+	// through to next.
+	bool aot_execute(int16_t instr, int16_t next);
+	// raw values of Trytes and Trints, for instructions compiled inline. Values assigned may be
+	// up to one range out either way, and are wrapped round into it.
+	static int16_t aot_value(Tryte const& t);
+	static void aot_assign(Tryte& t, int64_t value);
+	static int64_t aot_value(Trint<3> const& t);
+	static void aot_assign(Trint<3>& t, int64_t value);
+	// the address after addr, wrapping round memory
+	static int16_t aot_next(int16_t addr);
+	// -1, 0 or 1 as difference is negative, zero or positive
+	static int16_t aot_sign(int64_t difference);
+};
+
+// inline, so compiled blocks call straight into the handlers
+inline bool CPU::aot_execute(int16_t instr, int16_t next)
+{
+	// (the entry may not have been decoded yet, so its instr can't be used)
+	DecodedInstr const& decoded = _decode_table[instr + 9841];
+	aot_assign(_instr, instr);
+	decoded.handler(*this, decoded);
+	_clock += 1;
+	return _on and Tryte::get_int(_i_ptr) == next;
+}
+inline int16_t CPU::aot_value(Tryte const& t)
+{
+	static_assert(sizeof(Tryte) == sizeof(int16_t), "Tryte must be a bare int16_t");
+	return reinterpret_cast<int16_t const&>(t);
+}
+inline void CPU::aot_assign(Tryte& t, int64_t value)
+{
+	value = value > 9841 ? value - 19683 : (value < -9841 ? value + 19683 : value);
+	reinterpret_cast<int16_t&>(t) = static_cast<int16_t>(value);
+}
+inline int64_t CPU::aot_value(Trint<3> const& t)
+{
+	return (aot_value(t[0]) * int64_t(19683) + aot_value(t[1])) * 19683 + aot_value(t[2]);
+}
+inline void CPU::aot_assign(Trint<3>& t, int64_t value)
+{
+	// 3^27, and the largest Trint<3>
+	int64_t const modulus = 7625597484987;
+	int64_t const max = (modulus - 1) / 2;
+	value = value > max ? value - modulus : (value < -max ? value + modulus : value);
+	// the Trytes are the base 19683 digits of value + max, each 9841 too big
+	uint64_t digits = static_cast<uint64_t>(value + max);
+	for (size_t k = 3; k-- > 0;)
+	{
+		reinterpret_cast<int16_t&>(t[k]) = static_cast<int16_t>(digits % 19683) - 9841;
+		digits /= 19683;
+	}
+}
+inline int16_t CPU::aot_next(int16_t addr)
+{
+	return addr == 9841 ? -9841 : addr + 1;
+}
+inline int16_t CPU::aot_sign(int64_t difference)
+{
+	return difference > 0 ? 1 : (difference < 0 ? -1 : 0);
+}
\ No newline at end of file
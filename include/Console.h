@@ -1,9 +1,12 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <vector>
 #include "Tryte.h"
 #include "Trint.h"
 #include "Float.h"
+#include "InputDevice.h"
+#include "ReplayLog.h"
 class Console
 {
 private:
@@ -22,17 +25,67 @@ private:
 		graphics
 	} _output_mode;
 
+	// where output goes, and where input is read from (std::cout and std::cin, unless redirected)
+	std::ostream* _output;
+	std::istream* _input_stream;
+
+	// output waits here until the buffer fills, the computer halts or waits, or input is read -
+	// or, when output goes to a terminal, until the end of the line
+	std::string _buffer;
+	size_t _buffer_size;
+	bool _interactive;
+	// add text to the buffer, writing it out if it's time to
+	void write(char const* text, size_t length);
+	// pass the buffer on to the output stream
+	void write_buffer();
+
+	// the text printed for every Tryte in one output mode: Tryte t is lengths[t + 9841] chars,
+	// starting at text[(t + 9841) * stride]. Each mode's table is built the first time it's used.
+	struct TryteTexts
+	{
+		size_t stride;
+		std::vector<uint8_t> lengths;
+		std::vector<char> text;
+	};
+	static TryteTexts const* tryte_texts(OutputMode mode);
+	// the table for the current mode (nullptr until looked up)
+	TryteTexts const* _tryte_texts;
+	void write_tryte(TryteTexts const& texts, Tryte const& t);
+	// asynchronous input, if attached - otherwise input is read (blocking) from _input_stream
+	InputDevice* _input;
+	// log of what is read (at the clock given), if recording or replaying - see ReplayLog
+	ReplayLog* _log;
+	size_t const* _clock;
+
 public:
-	Console();
+	static size_t const default_buffer_size = 65536;
+
+	Console(std::ostream& output = std::cout, std::istream& input = std::cin);
+	// writes out anything still buffered
+	~Console();
 	Console& operator<<(Tryte& t);
 	Console& operator<<(Trint<3>& trint);
 	Console& operator<<(TFloat& tfloat);
 	Console& operator<<(char c);
 	Console& operator<<(std::string out_string);
-	Console& operator>>(char input);
+	Console& operator>>(char& input);
+
+	// read input from an input device rather than std::cin. Reads then never block - they give 0
+	// if no input is waiting.
+	void attach_input(InputDevice* input);
+	// record each character read in a log, stamped with clock; or, if the log is being replayed,
+	// read the characters from the log instead
+	void attach_log(ReplayLog* log, size_t const& clock);
+	// write output to, and read input from, other streams - so several computers can share a process
+	void redirect(std::ostream& output, std::istream& input);
+	// make sure everything printed so far has reached the terminal
+	void flush();
+	// buffer up to this many bytes of output before writing it out (0 - write everything at once)
+	void set_buffer_size(size_t bytes);
 
-	// output mode
+	// output mode (0 to 5, in the order of OutputMode)
 	int16_t get_output_mode();
+	void set_output_mode(int16_t mode);
 	void raw_mode();
 	void ternary_mode();
 	void number_mode();
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include "Tryte.h"
+#include "Memory.h"
+
+/*
+Disks
+A disk holds 19,683 Trytes, addressed 0 to 19,682. Two formats are supported:
+- text: septavingt Trytes separated by spaces, 4 characters per Tryte (the .tri files the assembler makes)
+- binary: an 8 byte header ("TRIDISK" followed by a version byte), then one int16_t per Tryte in
+  the host's byte order (little-endian on every supported target, which is what convert_disk.py
+  writes). Binary disks are memory-mapped when opened, so LOAD and SAVE are plain copies.
+Text disks are read into a buffer when opened, and SAVEs are written back by flush().
+tools/convert_disk.py converts between the two formats.
+*/
+class Disk
+{
+private:
+	std::string _filename;
+	bool _binary;
+	// file descriptor and mapping of a binary disk (-1 and nullptr for text disks)
+	int _fd;
+	unsigned char* _mapping;
+	// contents of a text disk
+	std::vector<int16_t> _buffer;
+	// number of Trytes actually in a text disk's file
+	size_t _text_length;
+	// the disk's Trytes - the mapping (just after the header) or the buffer
+	int16_t* _data;
+	// range of addresses changed since the last flush (empty if _dirty_begin >= _dirty_end)
+	size_t _dirty_begin;
+	size_t _dirty_end;
+
+	void open_binary();
+	void open_text();
+
+public:
+	// number of Trytes on a disk
+	static size_t const size = 19683;
+	// header at the start of a binary disk
+	static std::string const binary_header;
+
+	// open a disk, working out its format from the first bytes of the file.
+	// Binary disks shorter than a full disk are extended with zeroes.
+	Disk(std::string const& filename);
+	// flushes any unsaved changes
+	~Disk();
+	Disk(Disk const& other) = delete;
+	Disk& operator=(Disk const& other) = delete;
+
+	bool is_binary() const;
+	std::string const& filename() const;
+
+	// copy n Trytes from the disk, starting at disk_addr, into memory starting at mem_addr.
+	// Stops at the end of the disk (or the end of the file, for text disks); returns the number of Trytes copied.
+	size_t load(size_t disk_addr, size_t n, Memory<19683>& memory, Tryte const& mem_addr);
+	// copy n Trytes from memory, starting at mem_addr, onto the disk starting at disk_addr.
+	// Trytes that would go past the end of the disk are dropped.
+	void save(Memory<19683>& memory, Tryte const& mem_addr, size_t n, size_t disk_addr);
+	// write the range changed by SAVEs since the last flush back to the file
+	void flush();
+
+	// check whether a file starts with the binary disk header
+	static bool is_binary_file(std::string const& filename);
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Disk.h"
+
+/*
+Disk manager
+Opens every disk given on the command line once, when the computer starts, and keeps them open
+until it is switched off. Changes are flushed back to the files when another disk is mounted,
+on HALT, and when the manager is destroyed.
+*/
+class DiskManager
+{
+private:
+	std::vector<std::unique_ptr<Disk>> _disks;
+	// number of the mounted disk
+	size_t _mounted;
+
+public:
+	DiskManager(std::vector<std::string> const& disknames);
+	~DiskManager();
+	DiskManager(DiskManager const& other) = delete;
+	DiskManager& operator=(DiskManager const& other) = delete;
+
+	// number of disks
+	size_t size() const;
+	// mount disk n, flushing the previously mounted disk if it changes
+	void mount(size_t n);
+	// the mounted disk, and its number
+	Disk& mounted();
+	size_t mounted_number() const;
+	// flush changes on every disk
+	void flush();
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Memory.h"
+#include "Console.h"
+
+/*
+Display
+The graphics device, used in graphics mode (DSET 5). Memory from address i00 (6,561) is a
+framebuffer of 27 rows of 81 cells, row by row - cell (row, column) is at i00 + 81 * row + column.
+Each cell is a single Tryte, 128 * colour + glyph:
+- glyph (0 to 127) is an ASCII character; anything unprintable shows as a space
+- colour is foreground + 9 * background, each 0 (the terminal's default) or 1 to 8 (black, red,
+  green, yellow, blue, magenta, cyan, white). Both are taken modulo 9, so backgrounds 5 to 8 can
+  also be written as -4 to -1, keeping the Tryte in range.
+So a zero Tryte is a blank cell. A background thread draws frames at a steady rate, however fast
+the program runs: each frame sends the terminal ANSI escape sequences for only the cells that have
+changed since the last one. A last frame is drawn when the computer halts.
+*/
+class Display
+{
+public:
+	static int16_t const base = 6561;
+	static size_t const rows = 27;
+	static size_t const columns = 81;
+	static unsigned const default_frame_rate = 30;
+
+private:
+	Memory<19683>& _memory;
+	Console& _console;
+	std::mutex& _console_mutex;
+
+	// what the terminal shows - the cells as of the last frame
+	std::vector<int16_t> _shown;
+	// set once the screen has been cleared for the first frame
+	bool _started;
+	// escape sequences for the frame being drawn
+	std::string _frame;
+	// colour the terminal is drawing in (foreground + 9 * background, 0 - the defaults)
+	int _colour;
+
+	// frame thread, and what stops it (zero interval - no thread)
+	std::chrono::steady_clock::duration _frame_interval;
+	std::mutex _stop_mutex;
+	std::condition_variable _stop_signal;
+	bool _stopping;
+	std::thread _thread;
+
+	// body of the frame thread
+	void frame_loop();
+	// add a cell's text to the frame, changing colour first if need be
+	void draw_cell(int16_t cell);
+	void move_to(size_t cell);
+
+public:
+	// start drawing memory's framebuffer to the console, frame_rate times a second (0 - only
+	// when the computer halts). Output goes through the console while console_mutex is held.
+	Display(Memory<19683>& memory, Console& console, std::mutex& console_mutex, unsigned frame_rate);
+	~Display();
+	Display(Display const& other) = delete;
+	Display& operator=(Display const& other) = delete;
+
+	// stop the frame thread, or start it again (if there is a frame rate). No other thread uses
+	// console_mutex while the frame thread is stopped, so it is safe to fork().
+	void start();
+	void stop();
+	// forget what the terminal shows, so the next frame draws the whole screen - for when the
+	// console's output goes somewhere new. The caller must hold console_mutex.
+	void clear();
+	// draw the changes since the last frame now, if the console is in graphics mode. The caller
+	// must hold console_mutex.
+	void render();
+	// draw a last frame, and show the terminal's cursor again. The caller must hold console_mutex.
+	void finish();
+};
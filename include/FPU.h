@@ -1,30 +1,24 @@
 #pragma once
 #include <array>
+#include <mutex>
 #include "Float.h"
 #include "Memory.h"
 #include "Console.h"
+#include "Flags.h"
 
 class FPU
 {
 private:
-    // internal float registers
-    TFloat _f0;
-    TFloat _f1;
-    TFloat _f2;
-    TFloat _f3;
-    TFloat _f4;
-    TFloat _f5;
-    TFloat _f6;
-    TFloat _f7;
-    TFloat _f8;
-    std::array<TFloat*, 9> float_regs = {&_f0, &_f1, &_f2, &_f3, &_f4, &_f5, &_f6, &_f7, &_f8};
+    // internal float registers f0 to f8, side by side in one cache line
+    alignas(64) std::array<TFloat, 9> _float_regs;
 
     // access to main memory
     Memory<19683>& _memory;
-    // access to console
+    // access to console, and the lock held while using it (the console is shared by every core)
     Console& _console;
+    std::mutex& _console_mutex;
     // access to CPU flags
-    Tryte& _flags;
+    Flags& _flags;
 
     // access to instruction and stack pointers
     Tryte& _i_ptr;
@@ -106,13 +100,15 @@ private:
 
 public:
     // constructor
-    FPU(Memory<19683>& memory, Console& console, Tryte& flags, Tryte& i_ptr, Tryte& s_ptr);
+    FPU(Memory<19683>& memory, Console& console, std::mutex& console_mutex, Flags& flags, Tryte& i_ptr, Tryte& s_ptr);
     // error flag
     bool error;
     // instruction handler
     void handle_instr(Tryte instruction);
     // dump (for CPU dump)
     void dump();
+    // float register n (0 for f0, up to 8), for snapshots
+    TFloat& float_reg(size_t n);
     // reset - zeroes all registers, sets error flag to false, ready for new instruction
     void reset();
 };
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include "Tryte.h"
+
+/*
+CPU flags
+Kept as separate native fields, as instructions only ever set or test one flag at a time. The flags
+Tryte is only built (by pack) when something looks at it as a whole. Its layout is
+stored_interrupt (3 trits) | current_interrupt (3 trits) | overflow | carry | compare
+*/
+struct Flags
+{
+	// interrupt priorities, -13 to 13
+	int16_t stored_priority;
+	int16_t current_priority;
+	// single trits, -1 to 1
+	int16_t overflow;
+	int16_t carry;
+	int16_t compare;
+
+	Tryte pack() const
+	{
+		return Tryte(729 * stored_priority + 27 * current_priority + 9 * overflow + 3 * carry + compare);
+	}
+};
@@ -16,6 +16,7 @@ class TFloat
     TFloat(Trint<1> const& exponent, Trint<2> const& mantissa);
     TFloat(Tryte const& exponent_tryte, Tryte const& mantissa_tryte1, Tryte const& mantissa_tryte2);
     TFloat(TFloat const& other);
+    TFloat& operator=(TFloat const& other) = default;
 
     // relational operators
     bool operator==(TFloat const& other) const;
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CPU.h"
+
+/*
+Fork server
+Runs many variations of one program without booting it each time: the computer is booted and run
+up to a marker once, then cloned with fork() - one clone per line of a manifest,
+[< input.txt] [> output.txt]
+Each clone carries on from the marker with its own console input (none given - every read gives 0)
+and output (default: clone<n>.out, numbering lines from 1). Clones share the booted computer's memory
+copy-on-write, so a clone only copies the pages it changes, and never re-reads the program's disks.
+The marker is the first HALT (clones carry on from the instruction after it), or an address.
+Blank lines and lines starting with # are ignored. Disks are shared with the booted computer, so
+clones shouldn't SAVE to them. Linux (and other POSIX systems) only.
+*/
+class ForkServer
+{
+public:
+	struct Clone
+	{
+		std::string input_filename;
+		std::string output_filename;
+	};
+	struct Result
+	{
+		bool ok;
+		// host time from fork to exit
+		uint64_t us;
+	};
+
+private:
+	CPU& _cpu;
+	std::vector<Clone> _clones;
+	std::vector<Result> _results;
+
+	// body of a clone process - never returns
+	[[noreturn]] static void run_clone(CPU& cpu, Clone const& clone);
+
+public:
+	// read the clones in a manifest
+	ForkServer(CPU& cpu, std::string const& manifest_filename);
+
+	// run the (booted) computer to the marker: the first HALT, or the instruction at addr. The
+	// second returns false if the computer stopped before getting there.
+	void run_to_marker();
+	bool run_to_marker(Tryte const& addr);
+	// fork every clone, with at most max_running running at once (0 - one per hardware thread);
+	// returns the number that failed
+	size_t run(size_t max_running = 0);
+
+	size_t size() const;
+	Clone const& clone(size_t n) const;
+	Result const& result(size_t n) const;
+};
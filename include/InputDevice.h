@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+/*
+Input device
+Reads a file descriptor (normally stdin) on a background thread, so the CPU never stalls on a read.
+Bytes go into a single-producer single-consumer ring buffer: the input thread is the only writer and
+the CPU thread the only reader, so no locks are needed. Each time new input arrives, the on_input
+callback is called (from the input thread) - the CPU uses this to raise an interrupt.
+*/
+class InputDevice
+{
+public:
+	static size_t const buffer_size = 4096;
+
+private:
+	int _fd;
+	std::function<void()> _on_input;
+
+	// ring buffer - _head is the next slot to write, _tail the next slot to read. Both only ever
+	// increase; the slot is the index modulo buffer_size.
+	std::array<char, buffer_size> _buffer;
+	std::atomic<size_t> _head;
+	std::atomic<size_t> _tail;
+
+	// set once the input has hit end of file (or an error)
+	std::atomic<bool> _closed;
+
+	// pipe used to wake the input thread up when the device is destroyed
+	int _stop_pipe[2];
+	std::thread _thread;
+
+	// body of the input thread
+	void read_loop();
+
+public:
+	InputDevice(int fd, std::function<void()> on_input);
+	~InputDevice();
+	InputDevice(InputDevice const& other) = delete;
+	InputDevice& operator=(InputDevice const& other) = delete;
+
+	// take the next byte of input, if there is one. Never blocks.
+	bool read(char& c);
+	// number of bytes waiting to be read
+	size_t available() const;
+	// true once the input has ended and everything has been read
+	bool closed() const;
+};
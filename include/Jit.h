@@ -0,0 +1,131 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+/*
+JIT assembler
+A small x86-64 assembler for hot blocks of guest code (JitCompiler decides what to emit). It covers
+just the instructions the compiler needs, all on 64 bit registers, with memory operands of the form
+[base + index * scale + disp32]. Jumps go to labels, which can be bound before or after the jump.
+Finished code is copied into an mmapped arena that is only ever writable or executable, never both.
+Only supported on x86-64; elsewhere supported() is false and nothing is compiled.
+*/
+class Jit
+{
+public:
+	// compiled code - call it to run the block
+	typedef void (*Code)();
+
+	enum class Reg : uint8_t
+	{
+		rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8, r9, r10, r11, r12, r13, r14, r15,
+		// no register (as a memory operand's index)
+		none
+	};
+	// condition codes, as encoded in jcc, setcc and cmovcc
+	enum class Condition : uint8_t
+	{
+		o, no, b, ae, e, ne, be, a, s, ns, p, np, l, ge, le, g
+	};
+	// [base + index * scale + disp], scale 1, 2, 4 or 8
+	struct Mem
+	{
+		Reg base;
+		int32_t disp;
+		Reg index = Reg::none;
+		uint8_t scale = 1;
+	};
+	struct Label
+	{
+		size_t id;
+	};
+
+private:
+	unsigned char* _arena;
+	size_t _arena_size;
+	// bytes of the arena in use by installed blocks
+	size_t _used;
+	// code of the block being built, where each label is bound (or SIZE_MAX), and the rel32
+	// offsets that jump to each label, patched by install
+	std::vector<unsigned char> _code;
+	std::vector<size_t> _labels;
+	struct Fixup
+	{
+		size_t pos;
+		size_t label;
+	};
+	std::vector<Fixup> _fixups;
+
+	void emit(std::initializer_list<unsigned char> bytes);
+	void emit32(int32_t value);
+	void emit64(int64_t value);
+	// REX prefix for the given ModRM reg, SIB index and ModRM rm/SIB base registers (if needed)
+	void emit_rex(bool wide, Reg reg, Reg index, Reg base, bool force = false);
+	// ModRM (and SIB and displacement) for a register or a memory operand
+	void emit_modrm(Reg reg, Reg rm);
+	void emit_modrm(Reg reg, Mem const& mem);
+	// opcode with a register (or opcode extension) and a register operand, 64 bit
+	void emit_op(std::initializer_list<unsigned char> opcode, Reg reg, Reg rm);
+	void emit_op(std::initializer_list<unsigned char> opcode, Reg reg, Mem const& mem);
+	void emit_rel32(size_t label);
+
+public:
+	// arena_size is rounded up to whole pages
+	Jit(size_t arena_size);
+	~Jit();
+	Jit(Jit const& other) = delete;
+	Jit& operator=(Jit const& other) = delete;
+
+	static bool supported();
+
+	// start building a block
+	void begin();
+	Label new_label();
+	// the next instruction emitted is at label
+	void bind(Label label);
+
+	// moves (load16 sign extends a 16 bit value; store16 stores the low 16 bits)
+	void mov(Reg dst, Reg src);
+	void mov(Reg dst, int64_t imm);
+	void load16(Reg dst, Mem const& src);
+	void store16(Mem const& dst, Reg src);
+	void store16(Mem const& dst, int16_t imm);
+	void lea(Reg dst, Mem const& src);
+	// arithmetic
+	void add(Reg dst, Reg src);
+	void add(Reg dst, int32_t imm);
+	void add64(Mem const& dst, int32_t imm);
+	void sub(Reg dst, Reg src);
+	void sub(Reg dst, int32_t imm);
+	void neg(Reg dst);
+	void imul(Reg dst, Reg src, int32_t imm);
+	// rdx:rax = rax * src, unsigned
+	void mul(Reg src);
+	// comparisons, and what to do with the result
+	void cmp(Reg a, Reg b);
+	void cmp(Reg a, int32_t imm);
+	void cmp8(Mem const& a, int8_t imm);
+	void cmp16(Mem const& a, int16_t imm);
+	void test(Reg a, Reg b);
+	void set(Condition condition, Reg dst);
+	void cmov(Condition condition, Reg dst, Reg src);
+	// control flow
+	void jump(Label label);
+	void jump_if(Condition condition, Label label);
+	void call(Reg target);
+	void push(Reg reg);
+	void pop(Reg reg);
+	void ret();
+
+	// copy the block into the arena, and return it. Returns nullptr, leaving the block as it is,
+	// if the arena is full - after a reset, it can be installed again.
+	Code install();
+
+	// throw away every installed block
+	void reset();
+
+	// the condition that is true when condition is false
+	static Condition inverse(Condition condition);
+};
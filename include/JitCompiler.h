@@ -0,0 +1,111 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "CPU.h"
+#include "Jit.h"
+
+/*
+JIT compiler
+Translates a cached block of a CPU into x86-64 code, with Jit as the assembler. The common integer
+instructions (SET, ADD, INC, DEC, FLIP, ABS, SWAP, READ and WRITE on Tryte and Trint registers),
+CMP and the jumps are compiled inline:
+- Trint registers are kept in host registers (r12 to r15) as plain 64 bit integers for as long as
+  the block uses them, and only split back into Trytes when the block is left or calls a handler.
+  Tryte registers are worked on in place in the register file.
+- the compare flag lives in a host register (r10) from CMP to the jump that tests it.
+- the clock, instruction pointer and current instruction are only written when the block is left.
+Anything else calls its handler (through CPU::jit_call), with the CPU's state written back first.
+The rest of the time rbp points at the CPU and rbx at memory address 0. Memory is read and written
+with aligned 16 bit moves, which is what Memory::load and store compile to on x86-64, so compiled
+code keeps the memory model in CPU.h.
+*/
+class JitCompiler
+{
+private:
+	typedef Jit::Reg Reg;
+
+	// a host register holding a Trint register
+	struct Slot
+	{
+		// number of the Trint register (-1 if the slot is free)
+		int16_t trint;
+		// true if it has changed since it was loaded
+		bool dirty;
+	};
+
+	CPU& _cpu;
+	Jit& _jit;
+	std::vector<CPU::BlockOp> const& _block;
+
+	std::array<Slot, 4> _slots;
+	// slot to reuse next, if none are free
+	size_t _next_victim;
+	// true if the compare flag is in the compare register, rather than in _flags
+	bool _compare_in_reg;
+	// instructions run since the clock was last brought up to date
+	int32_t _ticks;
+	Jit::Label _epilogue;
+
+	// operands
+	Jit::Mem field(void const* member) const;
+	// Tryte k (0 is the most significant) of Trint register n
+	Jit::Mem trint_digit(int16_t n, size_t k) const;
+	// the Tryte at a fixed address (wrapping round memory), or at the address in a register
+	Jit::Mem memory_at(int64_t addr) const;
+	Jit::Mem memory_at(Reg addr) const;
+	// number of a Trint register, or of the one a Tryte register is part of
+	int16_t trint_number(Trint<3> const* reg) const;
+	int16_t trint_number(Tryte const* reg) const;
+
+	// Trint registers held in host registers
+	static Reg slot_reg(size_t slot);
+	// slot holding Trint register n (_slots.size() if none)
+	size_t slot_of(int16_t n) const;
+	// host register holding Trint register n, loading it unless the instruction overwrites it.
+	// keep is a Trint register the instruction also uses, which mustn't be pushed out.
+	Reg trint(int16_t n, bool load, int16_t keep = -1);
+	// Trint register n (which is in a slot) has been changed
+	void changed(int16_t n);
+	void write_back(size_t slot);
+	// write back and forget the Trint register a Tryte register is part of (it is about to be
+	// worked on in place)
+	void release(Tryte const* reg);
+	// write everything held in host registers back to the CPU, before a handler is called
+	void sync();
+
+	// arithmetic on values in host registers, all of which may use rax, rcx and rdx
+	// value of three Trytes, most significant first
+	void load_trint(Reg dst, Jit::Mem const& high, Jit::Mem const& mid, Jit::Mem const& low);
+	// value of the Tryte at the address in addr, and the two after it (addr is moved on)
+	void load_trint_at(Reg dst, Reg addr);
+	// split a Trint value back into three Trytes
+	void store_trint(Reg src, Jit::Mem const& high, Jit::Mem const& mid, Jit::Mem const& low);
+	// wrap the result of adding two Trints (or Trytes) back into range
+	void wrap_trint(Reg value);
+	void wrap_tryte(Reg value);
+	// the address after the one in addr (wrapping round memory)
+	void next_address(Reg addr);
+	// compare a with b, setting the compare flag
+	void compare(Reg a, Reg b);
+
+	// leave the block, writing back whatever is still held in host registers. The instruction
+	// pointer is set from the register i_ptr or the value i_ptr_value, and the current
+	// instruction to instr.
+	void exit(Reg const* i_ptr, Tryte const* i_ptr_value, Tryte const& instr);
+
+	// compile one instruction inline, if it can be (false if not)
+	bool compile_inline(CPU::BlockOp const& op);
+	bool compile_trint_op(CPU::BlockOp const& op);
+	bool compile_tryte_op(CPU::BlockOp const& op);
+	// a jump (which ends the block)
+	bool compile_jump(CPU::BlockOp const& op);
+	// call the instruction's handler
+	void compile_call(size_t i);
+
+public:
+	JitCompiler(CPU& cpu, Jit& jit, std::vector<CPU::BlockOp> const& block);
+
+	// emit the block's code into the JIT (ready for Jit::install)
+	void compile();
+};
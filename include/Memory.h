@@ -11,6 +11,19 @@ class Memory
 private:
 	std::vector<Tryte> _memory;
 
+	Tryte load_element(size_t index) const
+	{
+		static_assert(sizeof(Tryte) == sizeof(int16_t), "Trytes must be a bare int16_t");
+		// (copied, then overwritten, as a Tryte has no inline constructor from its raw value)
+		Tryte value = _memory[index];
+		*reinterpret_cast<int16_t*>(&value) = __atomic_load_n(reinterpret_cast<int16_t const*>(&_memory[index]), __ATOMIC_RELAXED);
+		return value;
+	}
+	void store_element(size_t index, Tryte value)
+	{
+		__atomic_store_n(reinterpret_cast<int16_t*>(&_memory[index]), Tryte::get_int(value), __ATOMIC_RELAXED);
+	}
+
 public:
 	Memory()
 	{
@@ -34,16 +47,73 @@ public:
 		int16_t tryte_val = Tryte::get_int(t);
 		return _memory[tryte_val + 9841];
 	}
+	// backing store, for bulk copies - address a is element a + (n - 1) / 2
+	Tryte* data()
+	{
+		return _memory.data();
+	}
+
+	/*
+	loads and stores, for cores sharing memory (see the memory model in CPU.h)
+	Every instruction reads and writes memory through these. They are relaxed atomic accesses to the
+	int16_t that holds the Tryte's value, so a Tryte is never torn, but they are unordered between
+	cores. On x86-64 they compile to plain moves, the same as the JIT emits.
+	*/
+	Tryte load(int const i) const
+	{
+		return load_element(i + ((n - 1) / 2));
+	}
+	Tryte load(Tryte t) const
+	{
+		return load_element(Tryte::get_int(t) + 9841);
+	}
+	void store(int const i, Tryte value)
+	{
+		store_element(i + ((n - 1) / 2), value);
+	}
+	void store(Tryte t, Tryte value)
+	{
+		store_element(Tryte::get_int(t) + 9841, value);
+	}
+
+	/*
+	atomic operations, for cores sharing memory (see the memory model in CPU.h)
+	Both are sequentially consistent, and act on the int16_t that holds the Tryte's value.
+	*/
+	// if the Tryte at address t is expected, replace it with desired and return true; otherwise
+	// set expected to the Tryte there and return false
+	bool compare_and_swap(Tryte t, Tryte& expected, Tryte desired)
+	{
+		static_assert(sizeof(Tryte) == sizeof(int16_t), "Trytes must be a bare int16_t");
+		int16_t* value = reinterpret_cast<int16_t*>(&(*this)[t]);
+		int16_t old_value = Tryte::get_int(expected);
+		bool swapped = __atomic_compare_exchange_n(value, &old_value, Tryte::get_int(desired), false,
+			__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+		expected = Tryte(old_value);
+		return swapped;
+	}
+	// add x to the Tryte at address t (wrapping round, as Trytes do), returning the Tryte that was there
+	Tryte fetch_add(Tryte t, Tryte x)
+	{
+		int16_t* value = reinterpret_cast<int16_t*>(&(*this)[t]);
+		int16_t old_value = __atomic_load_n(value, __ATOMIC_SEQ_CST);
+		while (!__atomic_compare_exchange_n(value, &old_value, Tryte::get_int(Tryte(old_value + Tryte::get_int(x))),
+			false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		{
+			// old_value now holds the Tryte another core put there - try again with that
+		}
+		return Tryte(old_value);
+	}
+
 	void dump_to_file(std::string& dump_filename)
 	{
 		// open dump file
 		std::ofstream dump_file(dump_filename);
 
-		// and dump contents of memory there
-		for (size_t i = 0; i < n; i++)
-		{
-			dump_file << _memory[i];
-		}
+		// and dump contents of memory there, as one run of septavingt text
+		std::string text(3 * n, '\0');
+		Tryte::septavingt_text(_memory.data(), n, &text[0]);
+		dump_file.write(text.data(), text.size());
 
 		// close file
 		dump_file.close();
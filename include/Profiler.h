@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "SourceMap.h"
+
+/*
+Profiler
+Counts the instructions the CPU executes, and the host time spent in them, per opcode family (the
+first septavingt digit of the instruction - 0XX, aXX, jXX, kXX, KXX, fXX and so on) and per
+instruction address. Only used when profiling is switched on: the CPU then runs instructions one
+at a time through a separate loop, so the normal loop pays nothing for it.
+Given the program's source map, the report also breaks the time down by function and source line.
+*/
+class Profiler
+{
+public:
+	// executions of, and host nanoseconds spent in, some set of instructions
+	struct Counter
+	{
+		uint64_t count;
+		uint64_t ns;
+	};
+
+private:
+	// indexed by the instruction's first septavingt digit + 13
+	std::array<Counter, 27> _families;
+	// indexed by address + 9841
+	std::vector<Counter> _addresses;
+	// the instruction last seen at each address
+	std::vector<int16_t> _instrs;
+	// source map of the boot disk (nullptr if there isn't one)
+	std::unique_ptr<SourceMap> _source_map;
+
+	// add up the counts of every address the map puts in the same function or line, and write
+	// the top ones by time
+	void report_ranges(std::ostream& out, std::string const& title, bool by_line, size_t top) const;
+
+public:
+	Profiler();
+
+	// record one execution of instr, at addr, taking ns nanoseconds
+	void record(int16_t instr, int16_t addr, uint64_t ns);
+	// counts for the address (-9841 to 9841)
+	Counter const& address(int16_t addr) const;
+	// attribute time to the functions and lines of the program in source_map
+	void set_source_map(std::unique_ptr<SourceMap> source_map);
+	// write the report: families sorted by time, then functions and lines if there is a source map,
+	// then the top_addresses hottest addresses
+	void report(std::ostream& out, size_t top_addresses = 20) const;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+Replay log
+Everything a run takes in from outside the computer, so the run can be repeated exactly: each
+character the console reads, each interrupt the CPU takes from the host (at CHK, WAIT or a dump)
+and how far the clock moved while the CPU slept in WAIT. Each event is stamped with the clock -
+the number of instructions run before it - and replaying feeds it back at that clock, so a replay
+needs no keyboard and takes no time asleep.
+File format: "TRIREPL" and a version byte (1), then one entry per event, in the order they happened:
+the event's kind (a byte: c, i or w), the clock less the previous event's clock, then the value
+(the character, the priority or the ticks slept). Both numbers are LEB128 varints, the value
+zigzag-encoded - most events take three bytes.
+*/
+class ReplayLog
+{
+public:
+	enum class Mode
+	{
+		record,
+		replay
+	};
+	enum class Event : char
+	{
+		// a character read by the console
+		input = 'c',
+		// an interrupt of the given priority, taken from the host
+		interrupt = 'i',
+		// clock ticks counted for time asleep in WAIT
+		wait = 'w'
+	};
+	static std::string const header;
+
+private:
+	Mode _mode;
+	// clock of the last event written or read
+	uint64_t _clock;
+
+	// recording
+	std::ofstream _record_file;
+	void write_varint(uint64_t n);
+
+	// replaying - the whole log, and the next event in it (if there is one)
+	std::vector<uint8_t> _log;
+	size_t _pos;
+	bool _has_next;
+	Event _next_kind;
+	int64_t _next_value;
+	uint64_t read_varint();
+	void read_next();
+
+public:
+	// start a new log, or open one to replay
+	ReplayLog(std::string const& filename, Mode mode);
+
+	bool replaying() const;
+	// add an event to the log being recorded
+	void record(Event kind, uint64_t clock, int64_t value);
+	// make sure everything recorded so far is in the file
+	void flush();
+
+	// if the next event in the log is kind at clock, take it, giving its value
+	bool next(Event kind, uint64_t clock, int64_t& value);
+	// as next, but the event must be there - if not, the program has gone a different way to the
+	// recorded run, and there's nothing left to replay
+	int64_t expect(Event kind, uint64_t clock);
+	// true once every event has been replayed
+	bool finished() const;
+};
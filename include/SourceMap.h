@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+Source map
+Where each function and source line of an assembled program ended up, as written by triangulate
+next to the .tri file (program.tri -> program.map). Each line of the file is one of
+fn NAME START END
+line FILE LINE START END
+with addresses in decimal, and END one past the last address. The boot disk is loaded at address 0,
+so these are also memory addresses.
+*/
+class SourceMap
+{
+public:
+	// a range of addresses [start, end) and what it was assembled from
+	struct Range
+	{
+		int16_t start;
+		int16_t end;
+		// function name, or source file name for lines
+		std::string name;
+		// source line (0 for functions)
+		size_t line;
+	};
+
+private:
+	std::vector<Range> _functions;
+	std::vector<Range> _lines;
+
+	static Range const* find(std::vector<Range> const& ranges, int16_t addr);
+
+public:
+	// read a map written by triangulate
+	SourceMap(std::string const& filename);
+
+	// function or line containing addr, or nullptr if the map doesn't cover it
+	Range const* function(int16_t addr) const;
+	Range const* line(int16_t addr) const;
+};
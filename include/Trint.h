@@ -16,67 +16,130 @@ private:
 	std::array<Tryte, n> _data;
 	static const std::string septavingt_chars;
 
-public:
 	/*
-	Constructors
+	native arithmetic
+	A Trint of up to three Trytes holds at most (3^27 - 1)/2 in magnitude, which fits
+	comfortably in an int64_t. For these, arithmetic is done on the integer value directly,
+	and wrapped back into range at the end.
 	*/
-	Trint()
+	static constexpr bool is_native = (n <= 3);
+
+	// 3^k
+	static constexpr int64_t power_of_3(size_t k)
 	{
-		for (size_t i = 0; i < n; i++)
+		int64_t output = 1;
+		for (size_t i = 0; i < k; i++)
 		{
-			_data[i] = 0;
+			output *= 3;
 		}
+		return output;
 	}
-	Trint(int64_t x)
+	// keep only the lowest k trits of x (reduce x mod 3^k into the balanced range)
+	static int64_t truncate(int64_t x, size_t k)
+	{
+		int64_t modulus = power_of_3(k);
+		int64_t half_modulus = (modulus - 1) / 2;
+		int64_t output = x % modulus;
+		if (output > half_modulus)
+		{
+			output -= modulus;
+		}
+		else if (output < -half_modulus)
+		{
+			output += modulus;
+		}
+		return output;
+	}
+	// wrap x into the range of a Trint<n>
+	static int64_t wrap(int64_t x)
 	{
-		/*
-		first generate a septavingtesmal representation of x
-		*/ 
-		int64_t dividend = x > 0 ? x : -x;
-		std::int16_t remainder = 0;
-		std::vector<int16_t> values;
+		return truncate(x, 9 * n);
+	}
+	// number of trits needed to write x (position of its highest nonzero trit)
+	static int64_t native_length(int64_t x)
+	{
+		int64_t magnitude = x > 0 ? x : -x;
+		int64_t output = 0;
+		// a number of k trits has magnitude at most (3^k - 1)/2
+		int64_t largest = 0;
+		while (largest < magnitude)
+		{
+			largest = 3 * largest + 1;
+			output++;
+		}
+		return output;
+	}
 
-		while (dividend != 0)
+	static std::array<Trint<n>, 2> native_div(int64_t dividend, int64_t divisor)
+	{
+		// same algorithm as div, on native integers: work down from the highest trit, at each
+		// step adding or subtracting the shifted divisor if it brings the dividend closer to zero
+		int64_t shift = native_length(dividend) - native_length(divisor);
+		int64_t quotient = 0;
+		if (shift < 0)
 		{
-			remainder = dividend % 27;
-			dividend = dividend / 27;
-			if (remainder > 13)
-			{
-				dividend++;
-				remainder -= 27;
-			}
-			else if (remainder < -13)
-			{
-				dividend--;
-				remainder += 27;
-			}
-			values.push_back(remainder);
+			std::array<Trint<n>, 2> output = {0, dividend};
+			return output;
 		}
-		if (x < 0)
+
+		while (shift >= 0)
 		{
-			for (auto& value : values)
+			int64_t shifted_divisor = wrap(divisor * power_of_3(shift));
+			int64_t shift_up = wrap(dividend + shifted_divisor);
+			int64_t shift_down = wrap(dividend - shifted_divisor);
+			int64_t abs_up = shift_up > 0 ? shift_up : -shift_up;
+			int64_t abs_down = shift_down > 0 ? shift_down : -shift_down;
+			int64_t abs_dividend = dividend > 0 ? dividend : -dividend;
+			int64_t min_element = std::min({abs_up, abs_dividend, abs_down});
+
+			if (min_element == abs_up)
 			{
-				value = -value;
+				// shift_up is smaller (disregarding signs)
+				dividend = shift_up;
+				quotient = wrap(quotient - power_of_3(shift));
 			}
-		}
-		// pad with zeroes if x is too small for Trint
-		if (values.size() < 3 * n)
-		{
-			for (size_t i = values.size(); i < 3 * n; i++)
+			else if (min_element == abs_down)
 			{
-				values.push_back(0);
+				// shift_down is smaller (disregarding signs)
+				dividend = shift_down;
+				quotient = wrap(quotient + power_of_3(shift));
 			}
+			// otherwise, shifting up or down gets us further away from zero - do nothing
+			shift -= 1;
 		}
 
-		/*
-		use values to fill Trytes in Trint
-		*/
-		std::reverse(values.begin(), values.end());
-		for (size_t tryte = 0; tryte < n; tryte++)
+		// make remainder positive
+		int64_t remainder = dividend;
+		if (remainder < 0)
 		{
-			_data[tryte] = 729 * values[3 * tryte] + 27 * values[(3 * tryte) + 1] + values[(3 * tryte) + 2];
+			remainder = wrap(remainder + (divisor > 0 ? divisor : -divisor));
 		}
 
+		std::array<Trint<n>, 2> output = {quotient, remainder};
+		return output;
+	}
+
+public:
+	/*
+	Constructors
+	*/
+	Trint()
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			_data[i] = 0;
+		}
+	}
+	Trint(int64_t x)
+	{
+		// peel Trytes off the bottom of x, least significant first -
+		// anything left over once the Trint is full is dropped
+		for (size_t i = 0; i < n; i++)
+		{
+			Tryte low_tryte = Tryte::truncate_int(x);
+			_data[n - i - 1] = low_tryte;
+			x = (x - Tryte::get_int(low_tryte)) / 19683;
+		}
 	}
 	Trint(Tryte const& tryte)
 	{
@@ -148,6 +211,11 @@ public:
 	*/
 	Trint<n> operator+(Trint<n> const& other) const
 	{
+		if constexpr (is_native)
+		{
+			return Trint<n>(Trint<n>::get_int(*this) + Trint<n>::get_int(other));
+		}
+
 		Trint<n> output;
 		Tryte carry;
 
@@ -176,12 +244,13 @@ public:
 	}
 	Trint<n> operator-(Trint<n> const& other) const
 	{
-		Trint<n> output = *this;
-		for (size_t i = 0; i < n; i++)
+		if constexpr (is_native)
 		{
-			output[i] = (*this)[i] - other[i];
+			return Trint<n>(Trint<n>::get_int(*this) - Trint<n>::get_int(other));
 		}
-		return output;
+
+		// negating a Trint is exact, so borrows are handled by the carries in operator+
+		return *this + (-other);
 	}
 	Trint<n>& operator-=(Trint<n> const& other)
 	{
@@ -190,6 +259,19 @@ public:
 	}
 	Trint<n> operator*(Trint<n> const& other) const
 	{
+		if constexpr (is_native)
+		{
+			// multiply by one Tryte of other at a time (Horner's method), wrapping as we go
+			// so every intermediate result stays well inside an int64_t
+			int64_t this_int = Trint<n>::get_int(*this);
+			int64_t output = 0;
+			for (size_t i = 0; i < n; i++)
+			{
+				output = wrap(wrap(output * 19683) + this_int * Tryte::get_int(other[i]));
+			}
+			return Trint<n>(output);
+		}
+
 		// store intermediate results in array of Trints
 		std::array<Trint<n>, n> products;
 
@@ -268,6 +350,11 @@ public:
 	}
 	bool operator<(Trint<n> const& other) const
 	{
+		if constexpr (is_native)
+		{
+			return Trint<n>::get_int(*this) < Trint<n>::get_int(other);
+		}
+
 		for (size_t i = 0; i < n; i++)
 		{
 			if ((*this)[i] < other[i])
@@ -295,6 +382,11 @@ public:
 	}
 	bool operator>(Trint<n> const& other) const
 	{
+		if constexpr (is_native)
+		{
+			return Trint<n>::get_int(*this) > Trint<n>::get_int(other);
+		}
+
 		for (size_t i = 0; i < n; i++)
 		{
 			if ((*this)[i] > other[i])
@@ -395,6 +487,12 @@ public:
 			return 0;
 		}
 
+		if constexpr (is_native)
+		{
+			// drop the trits that would be shifted off the top first, so the product can't overflow
+			return Trint<n>(truncate(Trint<n>::get_int(*this), 9 * n - k) * power_of_3(k));
+		}
+
 		// convert trint into a big array
 		std::array<int16_t, 9 * n> big_tern_array = Trint<n>::ternary_array(*this);
 
@@ -435,6 +533,13 @@ public:
 			return 0;
 		}
 
+		if constexpr (is_native)
+		{
+			// subtract off the lowest k trits, and what's left divides exactly by 3^k
+			int64_t x = Trint<n>::get_int(*this);
+			return Trint<n>((x - truncate(x, k)) / power_of_3(k));
+		}
+
 		// convert trint into a big array
 		std::array<int16_t, 9 * n> big_tern_array = Trint<n>::ternary_array(*this);
 
@@ -539,11 +644,28 @@ public:
 
 	static std::array<Trint<n>, 2> div(Trint<n> const& t1, Trint<n> const& t2)
 	{
+		std::array<Trint<n>, 2> output;
 		// if t2 == 0, throw an error
-		if (t2 == 0)
+		if (!Trint<n>::try_div(t1, t2, output))
 		{
 			throw std::runtime_error("Attempted to divide by zero.");
 		}
+		return output;
+	}
+
+	// divide without throwing - returns false (leaving output alone) if t2 is zero
+	static bool try_div(Trint<n> const& t1, Trint<n> const& t2, std::array<Trint<n>, 2>& output)
+	{
+		if (t2 == 0)
+		{
+			return false;
+		}
+
+		if constexpr (is_native)
+		{
+			output = native_div(Trint<n>::get_int(t1), Trint<n>::get_int(t2));
+			return true;
+		}
 
 		// compute 'size' of t1 and t2 - number of digits
 		int64_t size1 = 0;
@@ -576,8 +698,8 @@ public:
 		// if size2 > size1, stop here
 		if (size2 > size1)
 		{
-			std::array<Trint<n>, 2> output = {0, t1};
-			return output;
+			output = {0, t1};
+			return true;
 		}
 
 		int16_t shift = size1 - size2;
@@ -614,7 +736,6 @@ public:
 				// shifting up or down gets us further away from zero- do nothing
 				shift -= 1;
 			}
-			std::cout << '\n';
 		}
 		Trint<n> remainder = dividend;
 
@@ -631,8 +752,8 @@ public:
 			}
 		}
 		
-		std::array<Trint<n>, 2> output = {quotient, remainder};
-		return output;
+		output = {quotient, remainder};
+		return true;
 	}
 
 	static std::array<int16_t, 9 * n> ternary_array(Trint<n> const& x)
@@ -12,7 +12,30 @@ class Tryte
     static const std::string ternary_chars;
     static const std::string septavingt_chars;
 
-    
+    /*
+    packed trits
+    Each Tryte can also be viewed as two 9-bit masks; bit k of the first is set if trit k
+    (counting from the least significant trit) is +, bit k of the second is set if it is -.
+    Tritwise logic then comes down to a handful of bitwise operations on these masks.
+    */
+    // table of packed trits for every Tryte value (+ mask in the low 16 bits, - mask in the high 16)
+    static std::array<uint32_t, 19683> const& packed_trits_table();
+    // table of the values of every 9-bit mask, read as a ternary number of 0s and 1s
+    static std::array<int16_t, 512> const& mask_values_table();
+    // get the + and - masks of a Tryte
+    static uint16_t positive_trits(Tryte const& t);
+    static uint16_t negative_trits(Tryte const& t);
+    // rebuild a Tryte from its + and - masks
+    static Tryte from_trit_masks(uint16_t positive, uint16_t negative);
+
+    // tables for text conversion: the septavingt digits of every Tryte value, as a 4 byte group of
+    // characters (the 3 digits, then a NUL) to copy out with memcpy; the same for the text of every
+    // 3 trits (indexed by their + mask, then their - mask shifted up 3); and the value of each
+    // septavingt digit and trit character (-128 for other characters)
+    static std::array<uint32_t, 19683> const& septavingt_text_table();
+    static std::array<uint32_t, 64> const& trit_triple_table();
+    static std::array<int8_t, 256> const& septavingt_digit_table();
+    static std::array<int8_t, 256> const& trit_digit_table();
 
     public:
     
@@ -30,7 +53,8 @@ class Tryte
     // construct from ternary array
     Tryte(std::array<int16_t, 9>& tern_array);
     // copy constructor
-    Tryte(Tryte const& other);
+    Tryte(Tryte const& other) = default;
+    Tryte& operator=(Tryte const& other) = default;
 
     /*
     increment/decrement operators
@@ -86,6 +110,22 @@ class Tryte
     // convert Tryte into septavingtesmal string
     std::string static septavingt_string(Tryte const& t);
 
+    /*
+    bulk text conversion
+    For converting whole runs of Trytes, as disks and memory dumps do. Each Tryte's text is looked
+    up in a table and written with a single store, and parsing looks each character up in a table,
+    so no strings are made along the way.
+    */
+    // write the septavingt (3 chars) or ternary (9 chars) text of count Trytes to output, each
+    // followed by separator - or by nothing, if separator is '\0'. output needs room for
+    // count * 4 (or 10) chars with a separator, count * 3 (or 9) without. Returns the end of the text.
+    static char* septavingt_text(Tryte const* trytes, size_t count, char* output, char separator = '\0');
+    static char* ternary_text(Tryte const* trytes, size_t count, char* output, char separator = '\0');
+    // read whitespace-separated Trytes (3 septavingt digits or 9 trits each) from text, storing up
+    // to max_trytes of them in output. Tokens of any other length read as zero; a bad digit throws.
+    // Returns the number of Trytes read.
+    static size_t parse_text(char const* text, size_t length, Tryte* output, size_t max_trytes);
+
     /*
     Helpful functions
     */
@@ -138,4 +178,6 @@ class Tryte
     static size_t length(Tryte const& t);
     // divide two Trytes and store the quotient and remainder
     static std::array<Tryte, 2> div(Tryte& t1, Tryte& t2);
+    // divide without throwing - returns false (leaving output alone) if t2 is zero
+    static bool try_div(Tryte const& t1, Tryte const& t2, std::array<Tryte, 2>& output);
 };
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+Work-stealing pool
+Runs a fixed set of independent tasks, numbered 0 to count - 1, on a number of threads. The tasks
+are dealt out to the threads in contiguous runs up front; each thread works through its own queue
+from the back, and once that is empty steals from the front of the other threads' queues, so a
+thread stuck with a few long tasks doesn't hold up the rest. Each queue has its own lock, which is
+only contended when a thread steals.
+*/
+class WorkStealingPool
+{
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<size_t> tasks;
+	};
+
+	size_t _thread_count;
+	std::vector<std::unique_ptr<Queue>> _queues;
+
+	// take the next task for thread n - its own if it has one, otherwise one stolen from another thread
+	bool next_task(size_t n, size_t& task);
+	// body of each thread
+	void work(size_t n, std::function<void(size_t)> const& task);
+
+public:
+	// thread_count 0 means one thread per hardware thread
+	WorkStealingPool(size_t thread_count = 0);
+
+	size_t thread_count() const;
+	// run task(0) to task(count - 1), returning when all are done. task is called from several
+	// threads at once, and must not throw.
+	void run(size_t count, std::function<void(size_t)> const& task);
+};
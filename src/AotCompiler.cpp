@@ -0,0 +1,474 @@
+#include "AotCompiler.h"
+#include <algorithm>
+
+AotCompiler::AotCompiler(CPU& cpu) : _cpu(cpu)
+{
+}
+
+void AotCompiler::add_entry(int64_t addr)
+{
+	// Tryte(int64_t) wraps the address round memory, as the CPU does
+	int16_t entry = Tryte::get_int(Tryte(addr));
+	if (_blocks.count(entry) == 0 and std::find(_pending.begin(), _pending.end(), entry) == _pending.end())
+	{
+		_pending.push_back(entry);
+	}
+}
+
+void AotCompiler::compile()
+{
+	// the CPU boots at address 0
+	add_entry(0);
+	while (!_pending.empty())
+	{
+		int16_t addr = _pending.back();
+		_pending.pop_back();
+		compile_block(addr);
+	}
+}
+void AotCompiler::compile_block(int16_t addr)
+{
+	std::vector<Op>& block = _blocks[addr];
+	int64_t pos = addr;
+	while (true)
+	{
+		Tryte instr = _cpu._memory.load(Tryte(pos));
+		CPU::DecodedInstr decoded = _cpu.decode(instr);
+		int64_t next = pos + decoded.length;
+		block.push_back({ Tryte::get_int(Tryte(pos)), Tryte::get_int(instr), Tryte::get_int(Tryte(next)) });
+
+		// instructions with an address operand lead to code there
+		auto handler = decoded.handler;
+		if (handler == &CPU::handle<&CPU::jump> or handler == &CPU::handle<&CPU::jump_if_zero>
+			or handler == &CPU::handle<&CPU::jump_if_pos> or handler == &CPU::handle<&CPU::jump_if_neg>
+			or handler == &CPU::handle<&CPU::jump_and_store>
+			or handler == &CPU::handle_num<int16_t, &CPU::set_interrupt_ptr>)
+		{
+			add_entry(Tryte::get_int(_cpu._memory.load(Tryte(pos + 1))));
+		}
+
+		if (decoded.length == 0)
+		{
+			// only the FPU knows where this instruction ends - leave the rest to the interpreter
+			return;
+		}
+		if (!decoded.ends_block and block.size() < CPU::_max_block_size)
+		{
+			pos = next;
+			continue;
+		}
+
+		// a new block starts after the instruction, unless it never falls through
+		bool falls_through = handler != &CPU::handle<&CPU::halt_and_catch_fire>
+			and handler != &CPU::handle<&CPU::jump> and handler != &CPU::handle<&CPU::jump_and_store>
+			and handler != &CPU::handle<&CPU::pop_and_jump>
+			and handler != &CPU::handle_num<int16_t, &CPU::switch_thread>;
+		if (falls_through)
+		{
+			add_entry(next);
+		}
+		return;
+	}
+}
+
+size_t AotCompiler::size() const
+{
+	return _blocks.size();
+}
+
+void AotCompiler::write(std::ostream& out) const
+{
+	out << "// Generated by the ternary computer's ahead-of-time compiler - do not edit.\n";
+	out << "#include <cstdlib>\n";
+	out << "#include <utility>\n";
+	out << "#include \"CPU.h\"\n\n";
+	// the program's own tag type keeps its code apart from any other program's
+	out << "namespace\n{\nstruct Program;\n}\n\n";
+	out << "template <>\nstruct AotProgram<Program>\n{\n";
+	for (auto const& block : _blocks)
+	{
+		out << "\tstatic bool block_" << Tryte::septavingt_string(Tryte(block.first)) << "(CPU& cpu);\n";
+	}
+	out << "};\n\n";
+	for (auto const& block : _blocks)
+	{
+		write_block(out, block.first, block.second);
+	}
+
+	out << "namespace\n{\n\n";
+	out << "CPU::AotBlockEntry const blocks[] = {\n";
+	for (auto const& block : _blocks)
+	{
+		out << "\t{ " << block.first << ", &AotProgram<Program>::block_" << Tryte::septavingt_string(Tryte(block.first)) << " },\n";
+	}
+	out << "};\n";
+	out << "[[maybe_unused]] bool const registered = CPU::register_aot_blocks(blocks, " << _blocks.size() << ");\n\n";
+	out << "}\n";
+}
+void AotCompiler::write_block(std::ostream& out, int16_t addr, std::vector<Op> const& block) const
+{
+	out << "bool AotProgram<Program>::block_" << Tryte::septavingt_string(Tryte(addr)) << "(CPU& cpu)\n{\n";
+
+	out << "\tstatic int16_t const addrs[] = {";
+	for (size_t i = 0; i < block.size(); i++)
+	{
+		out << (i == 0 ? " " : ", ") << block[i].addr;
+	}
+	out << " };\n";
+	out << "\tstatic int16_t const instrs[] = {";
+	for (size_t i = 0; i < block.size(); i++)
+	{
+		out << (i == 0 ? " " : ", ") << block[i].instr;
+	}
+	out << " };\n";
+	out << "\tif (!cpu.aot_code_matches(addrs, instrs, " << block.size() << "))\n";
+	out << "\t{\n\t\treturn false;\n\t}\n";
+
+	// instructions run inline only update the clock, instruction pointer and current instruction
+	// when the block is left, or a handler's operation is called
+	size_t ticks = 0;
+	bool i_ptr_set = true;
+	for (size_t i = 0; i < block.size(); i++)
+	{
+		Op const& op = block[i];
+		CPU::DecodedInstr decoded = _cpu.decode(Tryte(op.instr));
+		bool last = i + 1 == block.size();
+		out << "\t// " << Tryte::septavingt_string(Tryte(op.addr)) << ": "
+			<< Tryte::septavingt_string(Tryte(op.instr)) << '\n';
+
+		if (write_inline(out, op, decoded))
+		{
+			ticks += 1;
+			i_ptr_set = false;
+			if (last)
+			{
+				auto handler = decoded.handler;
+				bool jumped = handler == &CPU::handle<&CPU::jump> or handler == &CPU::handle<&CPU::jump_if_zero>
+					or handler == &CPU::handle<&CPU::jump_if_neg> or handler == &CPU::handle<&CPU::jump_if_pos>;
+				if (!jumped)
+				{
+					out << "\tCPU::aot_assign(cpu._i_ptr, " << op.next << ");\n";
+				}
+				out << "\tCPU::aot_assign(cpu._instr, instrs[" << i << "]);\n";
+				out << "\tcpu._clock += " << ticks << ";\n";
+			}
+			continue;
+		}
+
+		// the operation sees the CPU as the interpreter would leave it
+		if (ticks > 0)
+		{
+			out << "\tcpu._clock += " << ticks << ";\n";
+			ticks = 0;
+		}
+		if (!i_ptr_set)
+		{
+			out << "\tCPU::aot_assign(cpu._i_ptr, " << op.addr << ");\n";
+			i_ptr_set = true;
+		}
+		if (!write_call(out, decoded, "instrs[" + std::to_string(i) + "]"))
+		{
+			// each instruction runs only if the one before fell through to it
+			if (last)
+			{
+				out << "\tcpu.aot_execute(instrs[" << i << "], " << op.next << ");\n";
+			}
+			else
+			{
+				out << "\tif (!cpu.aot_execute(instrs[" << i << "], " << op.next << "))\n";
+				out << "\t{\n\t\treturn true;\n\t}\n";
+			}
+			continue;
+		}
+		out << "\tcpu._clock += 1;\n";
+		if (!last)
+		{
+			out << "\tif (!cpu._on or CPU::aot_value(cpu._i_ptr) != " << op.next << ")\n";
+			out << "\t{\n\t\treturn true;\n\t}\n";
+		}
+	}
+	out << "\treturn true;\n}\n\n";
+}
+
+bool AotCompiler::write_inline(std::ostream& out, Op const& op, CPU::DecodedInstr const& decoded) const
+{
+	auto handler = decoded.handler;
+	std::string x = decoded.x == nullptr ? "" : tryte_reg(decoded.x);
+	std::string y = decoded.y == nullptr ? "" : tryte_reg(decoded.y);
+	std::string t = decoded.trint_x == nullptr ? "" : trint_reg(decoded.trint_x);
+	std::string u = decoded.trint_y == nullptr ? "" : trint_reg(decoded.trint_y);
+	// the operand after the instruction
+	std::string operand = memory_at(op.addr + 1);
+
+	if (handler == &CPU::handle<&CPU::noop>)
+	{
+	}
+	// Trint registers
+	else if (handler == &CPU::handle_trint_pair<&CPU::set_trint>)
+	{
+		out << "\t" << t << " = " << u << ";\n";
+	}
+	else if (handler == &CPU::handle_trint<&CPU::set_trint_to_num>)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			out << "\t" << t << "[" << k << "] = " << memory_at(op.addr + 1 + k) << ";\n";
+		}
+	}
+	else if (handler == &CPU::handle_trint<&CPU::read_trint> or handler == &CPU::handle_trint<&CPU::write_trint>)
+	{
+		bool read = handler == &CPU::handle_trint<&CPU::read_trint>;
+		out << "\t{\n\t\tint16_t addr = CPU::aot_value(" << operand << ");\n";
+		for (int k = 0; k < 3; k++)
+		{
+			if (k > 0)
+			{
+				out << "\t\taddr = CPU::aot_next(addr);\n";
+			}
+			std::string reg = t + "[" + std::to_string(k) + "]";
+			if (read)
+			{
+				out << "\t\t" << reg << " = cpu._memory.load(addr);\n";
+			}
+			else
+			{
+				out << "\t\tcpu._memory.store(addr, " << reg << ");\n";
+			}
+		}
+		out << "\t}\n";
+	}
+	else if (handler == &CPU::handle_trint_pair<&CPU::add_trints>)
+	{
+		out << "\tCPU::aot_assign(" << t << ", CPU::aot_value(" << t << ") + CPU::aot_value(" << u << "));\n";
+	}
+	else if (handler == &CPU::handle_trint<&CPU::add_num_to_trint>)
+	{
+		out << "\tCPU::aot_assign(" << t << ", CPU::aot_value(" << t << ") + " << trint_at(op.addr + 1) << ");\n";
+	}
+	else if (handler == &CPU::handle_trint<&CPU::inc_trint> or handler == &CPU::handle_trint<&CPU::dec_trint>)
+	{
+		out << "\tCPU::aot_assign(" << t << ", CPU::aot_value(" << t << ") "
+			<< (handler == &CPU::handle_trint<&CPU::inc_trint> ? '+' : '-') << " 1);\n";
+	}
+	else if (handler == &CPU::handle_trint<&CPU::flip_trint>)
+	{
+		out << "\tCPU::aot_assign(" << t << ", -CPU::aot_value(" << t << "));\n";
+	}
+	else if (handler == &CPU::handle_trint<&CPU::abs_trint>)
+	{
+		out << "\tCPU::aot_assign(" << t << ", std::abs(CPU::aot_value(" << t << ")));\n";
+	}
+	else if (handler == &CPU::handle_trint_pair<&CPU::compare_trints>)
+	{
+		out << "\tcpu._flags.compare = CPU::aot_sign(CPU::aot_value(" << t << ") - CPU::aot_value(" << u << "));\n";
+	}
+	else if (handler == &CPU::handle_trint<&CPU::compare_trint_to_num>)
+	{
+		out << "\tcpu._flags.compare = CPU::aot_sign(CPU::aot_value(" << t << ") - " << trint_at(op.addr + 1) << ");\n";
+	}
+	else if (handler == &CPU::handle_trint_pair<&CPU::swap_trints>)
+	{
+		out << "\tstd::swap(" << t << ", " << u << ");\n";
+	}
+	// Tryte registers
+	else if (handler == &CPU::handle_tryte_pair<&CPU::set_tryte>)
+	{
+		out << "\t" << x << " = " << y << ";\n";
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::set_tryte_to_num>)
+	{
+		out << "\t" << x << " = " << operand << ";\n";
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::read_tryte>)
+	{
+		out << "\t" << x << " = cpu._memory.load(CPU::aot_value(" << operand << "));\n";
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::write_tryte>)
+	{
+		out << "\tcpu._memory.store(CPU::aot_value(" << operand << "), " << x << ");\n";
+	}
+	else if (handler == &CPU::handle_tryte_pair<&CPU::add_trytes>)
+	{
+		// the sum wrapped into X, and the carry into Y and the carry flag
+		out << "\t{\n";
+		out << "\t\tint64_t sum = CPU::aot_value(" << x << ") + CPU::aot_value(" << y << ");\n";
+		out << "\t\tint16_t carry = sum > 9841 ? 1 : (sum < -9841 ? -1 : 0);\n";
+		out << "\t\tCPU::aot_assign(" << x << ", sum);\n";
+		out << "\t\tCPU::aot_assign(" << y << ", carry);\n";
+		out << "\t\tcpu._flags.carry = carry;\n";
+		out << "\t}\n";
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::add_num_to_tryte>)
+	{
+		out << "\tCPU::aot_assign(" << x << ", CPU::aot_value(" << x << ") + CPU::aot_value(" << operand << "));\n";
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::inc_tryte> or handler == &CPU::handle_tryte<&CPU::dec_tryte>)
+	{
+		out << "\tCPU::aot_assign(" << x << ", CPU::aot_value(" << x << ") "
+			<< (handler == &CPU::handle_tryte<&CPU::inc_tryte> ? '+' : '-') << " 1);\n";
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::flip_tryte>)
+	{
+		out << "\tCPU::aot_assign(" << x << ", -CPU::aot_value(" << x << "));\n";
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::abs_tryte>)
+	{
+		out << "\tCPU::aot_assign(" << x << ", std::abs(CPU::aot_value(" << x << ")));\n";
+	}
+	else if (handler == &CPU::handle_tryte_pair<&CPU::compare_trytes>)
+	{
+		out << "\tcpu._flags.compare = CPU::aot_sign(CPU::aot_value(" << x << ") - CPU::aot_value(" << y << "));\n";
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::compare_tryte_to_num>)
+	{
+		out << "\tcpu._flags.compare = CPU::aot_sign(CPU::aot_value(" << x << ") - CPU::aot_value(" << operand << "));\n";
+	}
+	else if (handler == &CPU::handle_tryte_pair<&CPU::swap_trytes>)
+	{
+		out << "\tstd::swap(" << x << ", " << y << ");\n";
+	}
+	// jumps (which end the block)
+	else if (handler == &CPU::handle<&CPU::jump>)
+	{
+		out << "\tcpu._i_ptr = " << operand << ";\n";
+	}
+	else if (handler == &CPU::handle<&CPU::jump_if_zero> or handler == &CPU::handle<&CPU::jump_if_neg>
+		or handler == &CPU::handle<&CPU::jump_if_pos>)
+	{
+		char const* test = handler == &CPU::handle<&CPU::jump_if_zero> ? " == 0"
+			: (handler == &CPU::handle<&CPU::jump_if_neg> ? " < 0" : " > 0");
+		out << "\tCPU::aot_assign(cpu._i_ptr, cpu._flags.compare" << test << " ? CPU::aot_value(" << operand << ") : "
+			<< Tryte::get_int(Tryte(op.addr + 2)) << ");\n";
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+bool AotCompiler::write_call(std::ostream& out, CPU::DecodedInstr const& decoded, std::string const& instr) const
+{
+	for (Call const& call : calls())
+	{
+		if (call.handler != decoded.handler)
+		{
+			continue;
+		}
+		out << "\tCPU::aot_assign(cpu._instr, " << instr << ");\n";
+		out << "\tcpu." << call.op << "(";
+		switch (call.operands)
+		{
+			case Operands::none:
+				break;
+			case Operands::tryte:
+				out << tryte_reg(decoded.x);
+				break;
+			case Operands::tryte_pair:
+				out << tryte_reg(decoded.x) << ", " << tryte_reg(decoded.y);
+				break;
+			case Operands::trint:
+				out << trint_reg(decoded.trint_x);
+				break;
+			case Operands::trint_pair:
+				out << trint_reg(decoded.trint_x) << ", " << trint_reg(decoded.trint_y);
+				break;
+			case Operands::number:
+				out << "int16_t(" << decoded.n << ")";
+				break;
+			case Operands::size:
+				out << "size_t(" << decoded.n << ")";
+				break;
+		}
+		out << ");\n";
+		return true;
+	}
+	return false;
+}
+std::vector<AotCompiler::Call> const& AotCompiler::calls()
+{
+	static std::vector<Call> const calls = {
+		{ &CPU::handle<&CPU::check_priority>, Operands::none, "check_priority" },
+		{ &CPU::handle<&CPU::clear_carry>, Operands::none, "clear_carry" },
+		{ &CPU::handle<&CPU::clear_compare>, Operands::none, "clear_compare" },
+		{ &CPU::handle<&CPU::clear_overflow>, Operands::none, "clear_overflow" },
+		{ &CPU::handle<&CPU::fence>, Operands::none, "fence" },
+		{ &CPU::handle<&CPU::fill>, Operands::none, "fill" },
+		{ &CPU::handle<&CPU::halt_and_catch_fire>, Operands::none, "halt_and_catch_fire" },
+		{ &CPU::handle<&CPU::jump_and_store>, Operands::none, "jump_and_store" },
+		{ &CPU::handle<&CPU::load>, Operands::none, "load" },
+		{ &CPU::handle<&CPU::pop_and_jump>, Operands::none, "pop_and_jump" },
+		{ &CPU::handle<&CPU::print>, Operands::none, "print" },
+		{ &CPU::handle<&CPU::save>, Operands::none, "save" },
+		{ &CPU::handle<&CPU::wait>, Operands::none, "wait" },
+		{ &CPU::handle_num<int16_t, &CPU::set_interrupt_ptr>, Operands::number, "set_interrupt_ptr" },
+		{ &CPU::handle_num<int16_t, &CPU::set_priority>, Operands::number, "set_priority" },
+		{ &CPU::handle_num<int16_t, &CPU::switch_thread>, Operands::number, "switch_thread" },
+		{ &CPU::handle_num<size_t, &CPU::mount>, Operands::size, "mount" },
+		{ &CPU::handle_num<size_t, &CPU::set_display_mode>, Operands::size, "set_display_mode" },
+		{ &CPU::handle_trint<&CPU::and_trint_by_num>, Operands::trint, "and_trint_by_num" },
+		{ &CPU::handle_trint<&CPU::div_trint_by_num>, Operands::trint, "div_trint_by_num" },
+		{ &CPU::handle_trint<&CPU::get_display_mode>, Operands::trint, "get_display_mode" },
+		{ &CPU::handle_trint<&CPU::mult_trint_by_num>, Operands::trint, "mult_trint_by_num" },
+		{ &CPU::handle_trint<&CPU::not_trint>, Operands::trint, "not_trint" },
+		{ &CPU::handle_trint<&CPU::or_trint_by_num>, Operands::trint, "or_trint_by_num" },
+		{ &CPU::handle_trint<&CPU::peek_trint>, Operands::trint, "peek_trint" },
+		{ &CPU::handle_trint<&CPU::pop_trint>, Operands::trint, "pop_trint" },
+		{ &CPU::handle_trint<&CPU::push_trint>, Operands::trint, "push_trint" },
+		{ &CPU::handle_trint<&CPU::set_display_mode>, Operands::trint, "set_display_mode" },
+		{ &CPU::handle_trint<&CPU::shift_trint_left>, Operands::trint, "shift_trint_left" },
+		{ &CPU::handle_trint<&CPU::shift_trint_right>, Operands::trint, "shift_trint_right" },
+		{ &CPU::handle_trint<&CPU::show_trint>, Operands::trint, "show_trint" },
+		{ &CPU::handle_trint<&CPU::tell_trint>, Operands::trint, "tell_trint" },
+		{ &CPU::handle_trint<&CPU::xor_trint_by_num>, Operands::trint, "xor_trint_by_num" },
+		{ &CPU::handle_trint_pair<&CPU::and_trints>, Operands::trint_pair, "and_trints" },
+		{ &CPU::handle_trint_pair<&CPU::div_trints>, Operands::trint_pair, "div_trints" },
+		{ &CPU::handle_trint_pair<&CPU::mult_trints>, Operands::trint_pair, "mult_trints" },
+		{ &CPU::handle_trint_pair<&CPU::or_trints>, Operands::trint_pair, "or_trints" },
+		{ &CPU::handle_trint_pair<&CPU::xor_trints>, Operands::trint_pair, "xor_trints" },
+		{ &CPU::handle_tryte<&CPU::and_tryte_by_num>, Operands::tryte, "and_tryte_by_num" },
+		{ &CPU::handle_tryte<&CPU::div_tryte_by_num>, Operands::tryte, "div_tryte_by_num" },
+		{ &CPU::handle_tryte<&CPU::fetch_add>, Operands::tryte, "fetch_add" },
+		{ &CPU::handle_tryte<&CPU::get_core>, Operands::tryte, "get_core" },
+		{ &CPU::handle_tryte<&CPU::get_display_mode>, Operands::tryte, "get_display_mode" },
+		{ &CPU::handle_tryte<&CPU::mult_tryte_by_num>, Operands::tryte, "mult_tryte_by_num" },
+		{ &CPU::handle_tryte<&CPU::not_tryte>, Operands::tryte, "not_tryte" },
+		{ &CPU::handle_tryte<&CPU::or_tryte_by_num>, Operands::tryte, "or_tryte_by_num" },
+		{ &CPU::handle_tryte<&CPU::peek_tryte>, Operands::tryte, "peek_tryte" },
+		{ &CPU::handle_tryte<&CPU::pop_tryte>, Operands::tryte, "pop_tryte" },
+		{ &CPU::handle_tryte<&CPU::push_tryte>, Operands::tryte, "push_tryte" },
+		{ &CPU::handle_tryte<&CPU::set_display_mode>, Operands::tryte, "set_display_mode" },
+		{ &CPU::handle_tryte<&CPU::shift_tryte_left>, Operands::tryte, "shift_tryte_left" },
+		{ &CPU::handle_tryte<&CPU::shift_tryte_right>, Operands::tryte, "shift_tryte_right" },
+		{ &CPU::handle_tryte<&CPU::show_tryte>, Operands::tryte, "show_tryte" },
+		{ &CPU::handle_tryte<&CPU::tell_tryte>, Operands::tryte, "tell_tryte" },
+		{ &CPU::handle_tryte<&CPU::where>, Operands::tryte, "where" },
+		{ &CPU::handle_tryte<&CPU::xor_tryte_by_num>, Operands::tryte, "xor_tryte_by_num" },
+		{ &CPU::handle_tryte_pair<&CPU::and_trytes>, Operands::tryte_pair, "and_trytes" },
+		{ &CPU::handle_tryte_pair<&CPU::compare_and_swap>, Operands::tryte_pair, "compare_and_swap" },
+		{ &CPU::handle_tryte_pair<&CPU::div_trytes>, Operands::tryte_pair, "div_trytes" },
+		{ &CPU::handle_tryte_pair<&CPU::mult_trytes>, Operands::tryte_pair, "mult_trytes" },
+		{ &CPU::handle_tryte_pair<&CPU::or_trytes>, Operands::tryte_pair, "or_trytes" },
+		{ &CPU::handle_tryte_pair<&CPU::xor_trytes>, Operands::tryte_pair, "xor_trytes" },
+	};
+	return calls;
+}
+
+std::string AotCompiler::tryte_reg(Tryte const* reg) const
+{
+	size_t index = reg - &_cpu._regs[0][0];
+	return "cpu._regs[" + std::to_string(index / 3) + "][" + std::to_string(index % 3) + "]";
+}
+std::string AotCompiler::trint_reg(Trint<3> const* reg) const
+{
+	return "cpu._regs[" + std::to_string(reg - _cpu._regs.data()) + "]";
+}
+std::string AotCompiler::memory_at(int64_t addr)
+{
+	// Tryte(int64_t) wraps the address round memory, as the CPU does
+	return "cpu._memory.load(" + std::to_string(Tryte::get_int(Tryte(addr))) + ")";
+}
+std::string AotCompiler::trint_at(int64_t addr)
+{
+	return "((CPU::aot_value(" + memory_at(addr) + ") * int64_t(19683) + CPU::aot_value(" + memory_at(addr + 1)
+		+ ")) * 19683 + CPU::aot_value(" + memory_at(addr + 2) + "))";
+}
@@ -0,0 +1,159 @@
+#include "BatchRunner.h"
+#include "CPU.h"
+#include "WorkStealingPool.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+BatchRunner::BatchRunner(std::string const& manifest_filename)
+{
+	_jit = false;
+	std::ifstream manifest(manifest_filename);
+	if (!manifest)
+	{
+		throw std::runtime_error("Could not open batch manifest " + manifest_filename + ".\n");
+	}
+
+	std::string text;
+	size_t line = 0;
+	while (std::getline(manifest, text))
+	{
+		line++;
+		Job job;
+		try
+		{
+			if (parse_job(text, job))
+			{
+				_jobs.push_back(job);
+			}
+		}
+		catch (std::runtime_error const& e)
+		{
+			throw std::runtime_error(manifest_filename + ", line " + std::to_string(line) + ": " + e.what());
+		}
+	}
+	_results.assign(_jobs.size(), { false, "not run", 0, 0 });
+}
+
+bool BatchRunner::parse_job(std::string const& text, Job& job)
+{
+	std::istringstream tokens(text);
+	std::string token;
+	while (tokens >> token)
+	{
+		if (token[0] == '#' and job.disk_filenames.empty())
+		{
+			break;
+		}
+		if (token == "<" or token == ">")
+		{
+			std::string& filename = token == "<" ? job.input_filename : job.output_filename;
+			if (!(tokens >> filename))
+			{
+				throw std::runtime_error("'" + token + "' needs a file name.\n");
+			}
+			continue;
+		}
+		job.disk_filenames.push_back(token);
+	}
+
+	if (job.disk_filenames.empty())
+	{
+		if (!job.input_filename.empty() or !job.output_filename.empty())
+		{
+			throw std::runtime_error("job has no disks.\n");
+		}
+		return false;
+	}
+	if (job.output_filename.empty())
+	{
+		std::string const& boot_disk = job.disk_filenames[0];
+		job.output_filename = boot_disk.substr(0, boot_disk.rfind('.')) + ".out";
+	}
+	return true;
+}
+
+void BatchRunner::enable_jit()
+{
+	_jit = true;
+}
+
+size_t BatchRunner::run(size_t thread_count)
+{
+	WorkStealingPool pool(thread_count);
+	pool.run(_jobs.size(), [this](size_t n) { run_job(n); });
+
+	size_t failed = 0;
+	for (Result const& result : _results)
+	{
+		failed += result.ok ? 0 : 1;
+	}
+	return failed;
+}
+
+void BatchRunner::run_job(size_t n)
+{
+	Job const& job = _jobs[n];
+	Result& result = _results[n];
+	auto start = std::chrono::steady_clock::now();
+	try
+	{
+		// no input file - reads fail, and the console feeds in zeroes
+		std::ifstream input_file;
+		std::istringstream no_input;
+		std::istream* input = &no_input;
+		if (!job.input_filename.empty())
+		{
+			input_file.open(job.input_filename);
+			if (!input_file)
+			{
+				throw std::runtime_error("Could not open input " + job.input_filename + ".\n");
+			}
+			input = &input_file;
+		}
+
+		std::ostringstream output;
+		std::vector<std::string> disk_filenames = job.disk_filenames;
+		// the computer is far too big for a thread's stack
+		auto memory = std::make_unique<Memory<19683>>();
+		auto cpu = std::make_unique<CPU>(*memory, disk_filenames);
+		cpu->redirect_console(output, *input);
+		if (_jit)
+		{
+			cpu->enable_jit();
+		}
+		cpu->boot();
+		cpu->run();
+		result.instructions = cpu->clock();
+
+		std::ofstream output_file(job.output_filename);
+		output_file << output.str();
+		if (!output_file)
+		{
+			throw std::runtime_error("Could not write " + job.output_filename + ".\n");
+		}
+		result.ok = true;
+		result.error.clear();
+	}
+	catch (std::exception const& e)
+	{
+		result.ok = false;
+		result.error = e.what();
+	}
+	result.us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+size_t BatchRunner::size() const
+{
+	return _jobs.size();
+}
+BatchRunner::Job const& BatchRunner::job(size_t n) const
+{
+	return _jobs[n];
+}
+BatchRunner::Result const& BatchRunner::result(size_t n) const
+{
+	return _results[n];
+}
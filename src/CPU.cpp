@@ -1,59 +1,172 @@
 #include "CPU.h"
 #include "Console.h"
 #include "FPU.h"
+#include "JitCompiler.h"
 #include <vector>
 #include <string>
 #include <array>
-#include <fstream>
 #include <stdexcept>
+#include <chrono>
+#include <fstream>
+#include <unistd.h>
 
-CPU::CPU(Memory<19683>& memory, std::vector<std::string>& disknames)
+CPU::CPU(Memory<19683>& memory, std::vector<std::string>& disknames) :
+	_memory(memory), _devices(std::make_shared<Devices>(disknames)), _disks(_devices->disks),
+	_console(_devices->console), _core(0)
+{
+	reset();
+}
+CPU::CPU(CPU& boot_core, int16_t core) :
+	_memory(boot_core._memory), _devices(boot_core._devices), _disks(_devices->disks),
+	_console(_devices->console), _core(core)
+{
+	if (core < 1 or static_cast<size_t>(core) >= max_cores)
+	{
+		throw std::runtime_error("A computer can only have cores 0 to " + std::to_string(max_cores - 1) + ".\n");
+	}
+	reset();
+}
+
+void CPU::reset()
 {
-	_memory = memory;
-	_disknames = disknames;
-	_console = Console();
 	_clock = 0;
 	_on = false;
+	_interrupt_pending = false;
+	_pending_priority = 0;
+	_profile_output = nullptr;
 	// zero all registers
-	for (auto& reg : trint_regs)
+	for (auto& reg : _regs)
 	{
-		*reg = 0;
+		reg = 0;
 	}
 	_i_ptr = Tryte(0);
-	_s_ptr = Tryte("MMM");
+	// each core's stack starts at its own slice of the lower half of memory
+	_s_ptr = Tryte(-9841 + 729 * _core);
 	// set up interrupt array - on boot, all interrupts point to 000
 	for (auto& int_ptr : _int_ptrs)
 	{
 		int_ptr = Tryte(0);
 	}
 
-	// set disk to 0
-	_disk_num = 0;
-
 	// set instruction to 0
 	_instr = Tryte(0);
 
 	// initialise flags - stored interrupt priority is -13, current thread has priority 0.
 	// overflow, carry and compare flags set to 0.
-	_flags = Tryte("M00");
+	_flags = { -13, 0, 0, 0, 0 };
+
+	// instructions are decoded once, into a table, so execution is just a table lookup
+	build_decode_table();
+	_block_cache.resize(19683);
+
+	// pick up any blocks compiled ahead of time
+	if (!aot_registry().empty())
+	{
+		_aot_blocks.assign(19683, nullptr);
+		for (AotBlockEntry const& entry : aot_registry())
+		{
+			_aot_blocks[entry.addr + 9841] = entry.block;
+		}
+	}
 }
 
 void CPU::fetch()
 {
-	_instr = _memory[_i_ptr];
+	_instr = _memory.load(_i_ptr);
 }
 
 void CPU::decode_and_execute()
 {
-	std::string instruction = Tryte::septavingt_string(_instr);
+	DecodedInstr const& decoded = _decode_table[Tryte::get_int(_instr) + 9841];
+	decoded.handler(*this, decoded);
+}
+
+void CPU::build_decode_table()
+{
+	DecodedInstr undecoded = { &CPU::handle_undecoded, nullptr, nullptr, nullptr, nullptr, 0, 0, Tryte(0), true };
+	_decode_table.assign(19683, undecoded);
+}
+void CPU::handle_undecoded(CPU& cpu, DecodedInstr const& decoded)
+{
+	// work out which instruction this is from the entry's place in the table
+	size_t index = &decoded - cpu._decode_table.data();
+	DecodedInstr& entry = cpu._decode_table[index];
+	entry = cpu.decode(Tryte(static_cast<int64_t>(index) - 9841));
+	entry.handler(cpu, entry);
+}
+
+template <void (CPU::*op)()>
+void CPU::handle(CPU& cpu, DecodedInstr const&)
+{
+	(cpu.*op)();
+}
+template <void (CPU::*op)(Tryte&)>
+void CPU::handle_tryte(CPU& cpu, DecodedInstr const& decoded)
+{
+	(cpu.*op)(*decoded.x);
+}
+template <void (CPU::*op)(Tryte&, Tryte&)>
+void CPU::handle_tryte_pair(CPU& cpu, DecodedInstr const& decoded)
+{
+	(cpu.*op)(*decoded.x, *decoded.y);
+}
+template <void (CPU::*op)(Trint<3>&)>
+void CPU::handle_trint(CPU& cpu, DecodedInstr const& decoded)
+{
+	(cpu.*op)(*decoded.trint_x);
+}
+template <void (CPU::*op)(Trint<3>&, Trint<3>&)>
+void CPU::handle_trint_pair(CPU& cpu, DecodedInstr const& decoded)
+{
+	(cpu.*op)(*decoded.trint_x, *decoded.trint_y);
+}
+template <typename N, void (CPU::*op)(N)>
+void CPU::handle_num(CPU& cpu, DecodedInstr const& decoded)
+{
+	(cpu.*op)(decoded.n);
+}
+void CPU::handle_float(CPU& cpu, DecodedInstr const& decoded)
+{
+	// pass instruction to FPU - FPU will decode and execute the instruction
+	cpu._FPU.handle_instr(decoded.instr);
+	if (cpu._FPU.error)
+	{
+		cpu.halt_and_catch_fire();
+	}
+}
+template <int16_t taken_sign>
+void CPU::handle_compare_and_jump(CPU& cpu, DecodedInstr const& decoded)
+{
+	// same effect as the two instructions, but the comparison goes straight to the branch
+	int16_t sign = cpu.compare_sign(decoded);
+	cpu._flags.compare = sign;
+	Tryte jump_addr = cpu._i_ptr + decoded.length;
+	if (sign == taken_sign)
+	{
+		cpu._i_ptr = cpu._memory.load(jump_addr + 1);
+	}
+	else
+	{
+		cpu._i_ptr = jump_addr + 2;
+	}
+}
+
+CPU::DecodedInstr CPU::decode(Tryte const& instr)
+{
+	std::string instruction = Tryte::septavingt_string(instr);
 	char first = instruction[0];
 	char second = instruction[1];
 	char third = instruction[2];
-	std::array<int16_t, 9> tern_array = Tryte::ternary_array(_instr);
+	std::array<int16_t, 9> tern_array = Tryte::ternary_array(instr);
 	int16_t high_2 = 3 * tern_array[3] + tern_array[4] + 4;
 	int16_t mid_2 = 3 * tern_array[5] + tern_array[6] + 4;
 	int16_t low_2 = 3 * tern_array[7] + tern_array[8] + 4;
+	int16_t mid_3 = 9 * tern_array[3] + 3 * tern_array[4] + tern_array[5];
 	int16_t low_3 = 9 * tern_array[6] + 3 * tern_array[7] + tern_array[8];
+
+	// anything not recognised below halts the CPU
+	DecodedInstr decoded = { &CPU::handle<&CPU::halt_and_catch_fire>,
+		nullptr, nullptr, nullptr, nullptr, 0, 1, instr, true };
 	switch (first)
 	{
 		case '0':
@@ -66,74 +179,77 @@ void CPU::decode_and_execute()
 			{
 				case '0':
 					// 000 - HALT
-					halt_and_catch_fire();
+					decoded.handler = &CPU::handle<&CPU::halt_and_catch_fire>;
 					break;
 				case 'a':
 					// 00a - NOOP
-					noop();
+					decoded.handler = &CPU::handle<&CPU::noop>;
 					break;
 				case 'A':
 					// 00A - WAIT
-					wait();
-					break;
-				
-				default:
-					halt_and_catch_fire();
+					decoded.handler = &CPU::handle<&CPU::wait>;
 					break;
 			}
 			break;
 
+			case 'd':
+				// 0dX - CORE X
+				decoded.handler = &CPU::handle_tryte<&CPU::get_core>;
+				decoded.x = tryte_reg(low_3);
+				break;
+
 			case 'a':
 			// 0aX - compare flag management
 			switch (third)
 			{
 				case '0':
 					// 0a0 - CCMP
-					clear_compare();
+					decoded.handler = &CPU::handle<&CPU::clear_compare>;
 					break;
 				case 'A':
 					// 0aA - CCAR
-					clear_carry();
+					decoded.handler = &CPU::handle<&CPU::clear_carry>;
 					break;
 				case 'a':
 					// 0aa - COVF
-					clear_overflow();
+					decoded.handler = &CPU::handle<&CPU::clear_overflow>;
 					break;
-				
-				default:
-				halt_and_catch_fire();
-				break;
 			}
 			break;
 
 			case 'b':
 				// 0b - PJP
-				pop_and_jump();
+				decoded.handler = &CPU::handle<&CPU::pop_and_jump>;
 				break;
 
 			case 'B':
 				// 0B - jump and store
-				jump_and_store();
+				decoded.handler = &CPU::handle<&CPU::jump_and_store>;
+				decoded.length = 2;
 				break;
 
 			case 'c':
 				// 0c - CHK
-				check_priority();
+				decoded.handler = &CPU::handle<&CPU::check_priority>;
 				break;
 
 			case 'h':
 				// 0hn - THD n
-				switch_thread(low_3);
+				decoded.handler = &CPU::handle_num<int16_t, &CPU::switch_thread>;
+				decoded.n = low_3;
 				break;
 
 			case 'I':
 				// 0In - PRI n
-				set_priority(low_3);
+				decoded.handler = &CPU::handle_num<int16_t, &CPU::set_priority>;
+				decoded.n = low_3;
 				break;
 
 			case 'i':
 				// 0in - INT $x, n
-				set_interrupt_ptr(low_3);
+				decoded.handler = &CPU::handle_num<int16_t, &CPU::set_interrupt_ptr>;
+				decoded.length = 2;
+				decoded.n = low_3;
 				break;
 
 			case 'j':
@@ -142,47 +258,45 @@ void CPU::decode_and_execute()
 				{
 					case '0':
 						// 0j0 - JPZ $X
-						jump_if_zero();
+						decoded.handler = &CPU::handle<&CPU::jump_if_zero>;
+						decoded.length = 2;
 						break;
-						
+
 					case 'a':
 						// 0ja - JPP $X
-						jump_if_pos();
+						decoded.handler = &CPU::handle<&CPU::jump_if_pos>;
+						decoded.length = 2;
 						break;
 
 					case 'A':
 					    // 0jA - JPN $X
-						jump_if_neg();
+						decoded.handler = &CPU::handle<&CPU::jump_if_neg>;
+						decoded.length = 2;
 						break;
 
 					case 'm':
 						// 0jm - JPS $X
-						jump_and_store();
+						decoded.handler = &CPU::handle<&CPU::jump_and_store>;
+						decoded.length = 2;
 						break;
 
 					case 'M':
 						// 0jM - PJP
-						pop_and_jump();
+						decoded.handler = &CPU::handle<&CPU::pop_and_jump>;
 						break;
 
 					case 'j':
 						// 0jj - JP $X
-						jump();
-						break;
-
-					default:
-						halt_and_catch_fire();
+						decoded.handler = &CPU::handle<&CPU::jump>;
+						decoded.length = 2;
 						break;
 				}
 				break;
 
 			case 'm':
 				// 0m - MOUNT n
-				mount(low_3 + 13);
-				break;
-
-			default:
-				halt_and_catch_fire();
+				decoded.handler = &CPU::handle_num<size_t, &CPU::mount>;
+				decoded.n = low_3 + 13;
 				break;
 		}
 	    break;
@@ -193,41 +307,60 @@ void CPU::decode_and_execute()
 			{
 				case 'A':
 					// aAY - READ $X, Y
-					read_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::read_tryte>;
+					decoded.length = 2;
+					decoded.x = tryte_reg(low_3);
 					break;
 
 				case 'a':
 					// aaY - READ $X, Y
-					read_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::read_trint>;
+					decoded.length = 2;
+					decoded.trint_x = trint_reg(low_2);
 					break;
 
 				case 'B':
 					// aBX - WRITE X, $Y
-					write_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::write_tryte>;
+					decoded.length = 2;
+					decoded.x = tryte_reg(low_3);
 					break;
 
 				case 'b':
 					// abX - WRITE X, $Y
-					write_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::write_trint>;
+					decoded.length = 2;
+					decoded.trint_x = trint_reg(low_2);
 					break;
 
 				case 'f':
 					// af - FILL $X, N, K
-					fill();
+					decoded.handler = &CPU::handle<&CPU::fill>;
+					decoded.length = 4;
 					break;
 
 				case 'M':
 					// aM - LOAD $X, N, $Y
-					load();
+					decoded.handler = &CPU::handle<&CPU::load>;
+					decoded.length = 4;
 					break;
 
 				case 'm':
 					// am - SAVE $X, N, $Y
-					save();
+					decoded.handler = &CPU::handle<&CPU::save>;
+					decoded.length = 4;
 					break;
 
-				default:
-					halt_and_catch_fire();
+				case 'e':
+					// aeX - FADD X, $Y
+					decoded.handler = &CPU::handle_tryte<&CPU::fetch_add>;
+					decoded.length = 2;
+					decoded.x = tryte_reg(low_3);
+					break;
+
+				case 'F':
+					// aF - FENCE
+					decoded.handler = &CPU::handle<&CPU::fence>;
 					break;
 			}
 			break;
@@ -238,366 +371,579 @@ void CPU::decode_and_execute()
 			{
 				case '0':
 					// b0X - WHERE X
-					where(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::where>;
+					decoded.x = tryte_reg(low_3);
 					break;
 
 				case 'A':
 					// bAX - PUSH X
-					push_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::push_tryte>;
+					decoded.x = tryte_reg(low_3);
 					break;
 
 				case 'a':
 					// baX - PUSH X
-					push_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::push_trint>;
+					decoded.trint_x = trint_reg(low_2);
 					break;
 
 				case 'B':
 					// bBX - POP X
-					pop_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::pop_tryte>;
+					decoded.x = tryte_reg(low_3);
 					break;
 
 				case 'b':
 					// bbX - POP X
-					pop_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::pop_trint>;
+					decoded.trint_x = trint_reg(low_2);
 					break;
 
 				case 'M':
 					// bMX - PEEK X
-					peek_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::peek_tryte>;
+					decoded.x = tryte_reg(low_3);
 					break;
 
 				case 'm':
 					// bmX - PEEK X
-					peek_trint(*trint_regs[low_2]);
-					break;
-
-				default:
-					halt_and_catch_fire();
+					decoded.handler = &CPU::handle_trint<&CPU::peek_trint>;
+					decoded.trint_x = trint_reg(low_2);
 					break;
 			}
 			break;
-		
+
 		case 'c':
 			// cXX - console management
 			switch (second)
 			{
 				case '0':
 					// c0 - PRINT $X, n
-					print();
+					decoded.handler = &CPU::handle<&CPU::print>;
+					decoded.length = 3;
 					break;
 				case 'a':
 					// caX - DSET X
-					set_display_mode(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::set_display_mode>;
+					decoded.length = 2;
+					decoded.trint_x = trint_reg(low_2);
 					break;
 				case 'A':
 					// cAX - DSET X
-					set_display_mode(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::set_display_mode>;
+					decoded.length = 2;
+					decoded.x = tryte_reg(low_3);
 					break;
 				case 'b':
 					// cbX - DGET X
-					get_display_mode(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::get_display_mode>;
+					decoded.trint_x = trint_reg(low_2);
 					break;
 				case 'B':
 					// cBX - DGET X
-					get_display_mode(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::get_display_mode>;
+					decoded.x = tryte_reg(low_3);
 					break;
 				case 'c':
 					// ccX - SHOW X
-					show_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::show_trint>;
+					decoded.trint_x = trint_reg(low_2);
 					break;
 				case 'C':
 					// cCX - SHOW X
-					show_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::show_tryte>;
+					decoded.x = tryte_reg(low_3);
 					break;
 				case 'd':
 					// cdX - TELL X
-					tell_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::tell_trint>;
+					decoded.trint_x = trint_reg(low_2);
 					break;
 				case 'D':
 					// cDX - TELL X
-					tell_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::tell_tryte>;
+					decoded.x = tryte_reg(low_3);
 					break;
 				case 'm':
 					// cmn - DSET n
-					set_display_mode(low_3 + 13);
-					break; 
+					decoded.handler = &CPU::handle_num<size_t, &CPU::set_display_mode>;
+					decoded.n = low_3 + 13;
+					break;
 			}
-			break; 
+			break;
 
 		case 'A':
 			// AXY - add trytes
 			// ADD X, Y
-			add_trytes(*tryte_regs[second], *tryte_regs[third]);
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::add_trytes>;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
 			break;
-		
+
 		case 'B':
 			// BXY - set tryte to tryte
 			// SET X, Y
-			set_tryte(*tryte_regs[second], *tryte_regs[third]);
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::set_tryte>;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
 			break;
 
 		case 'C':
 			// CXY - compare tryte to tryte
 			// CMP X, Y
-			compare_trytes(*tryte_regs[second], *tryte_regs[third]);
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::compare_trytes>;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
 			break;
 
 		case 'D':
 			// DXY - divide tryte by tryte
 			// DIV X, Y
-			div_trytes(*tryte_regs[second], *tryte_regs[third]);
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::div_trytes>;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
+			break;
+
+		case 'd':
+			// dXY - compare and swap
+			// CAS X, Y, $Z
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::compare_and_swap>;
+			decoded.length = 2;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
 			break;
 
 		case 'E':
 			// EXY - multiply tryte by tryte
 			// MUL X, Y
-			mult_trytes(*tryte_regs[second], *tryte_regs[third]);
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::mult_trytes>;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
 			break;
 
 		case 'f':
-			// fXY - floating point operations
-			// pass instruction to FPU - FPU will decode and execute the instruction
-			_FPU.handle_instr(instruction);
-			if (_FPU.error)
-			{
-				halt_and_catch_fire();
-			}
-			break;
-		
 		case 'g':
-			// gXY - floating point operations
-			// pass instruction to FPU - FPU will decode and execute the instruction
-			_FPU.handle_instr(instruction);
-			if (_FPU.error)
-			{
-				halt_and_catch_fire();
-			}
+			// fXY, gXY - floating point operations
+			decoded.handler = &CPU::handle_float;
+			// the FPU decodes its own operands, so the length isn't known here
+			decoded.length = 0;
 			break;
 
 		case 'F':
 			// FXY - AND trytes
 			// AND X, Y
-			and_trytes(*tryte_regs[second], *tryte_regs[third]);
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::and_trytes>;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
 			break;
 
 		case 'G':
 			// GXY - OR trytes
 			// OR X, Y
-			or_trytes(*tryte_regs[second], *tryte_regs[third]);
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::or_trytes>;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
 			break;
 
 		case 'H':
 			// HXY - XOR trytes
 			// XOR X, Y
-			xor_trytes(*tryte_regs[second], *tryte_regs[third]);
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::xor_trytes>;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
 			break;
 
 		case 'I':
 			// IXY - swap trytes
 			// SWAP X, Y
-			swap_trytes(*tryte_regs[second], *tryte_regs[third]);
+			decoded.handler = &CPU::handle_tryte_pair<&CPU::swap_trytes>;
+			decoded.x = tryte_reg(mid_3);
+			decoded.y = tryte_reg(low_3);
 			break;
 
 		case 'j':
 			// jXY - Trint pair operations
+			decoded.trint_x = trint_reg(mid_2);
+			decoded.trint_y = trint_reg(low_2);
 			switch (high_2)
 			{
 				case 0:
 					// j(M-K)(M-m) - SET3 X, Y
-					set_trint(*trint_regs[mid_2], *trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint_pair<&CPU::set_trint>;
 					break;
-				
+
 				case 1:
 					// j(J-H)(M-m) - CMP3 X, Y
-					compare_trints(*trint_regs[mid_2], *trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint_pair<&CPU::compare_trints>;
 					break;
-				
+
 				case 2:
 					// j(G-E)(M-m) - ADD3 X, Y
-					add_trints(*trint_regs[mid_2], *trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint_pair<&CPU::add_trints>;
 					break;
-				
+
 				case 3:
 					// j(D-B)(M-m) - MUL3 X, Y
-					mult_trints(*trint_regs[mid_2], *trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint_pair<&CPU::mult_trints>;
 					break;
-				
+
 				case 4:
 					// j(A-a)(M-m) - DIV3 X, Y
-					div_trints(*trint_regs[mid_2], *trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint_pair<&CPU::div_trints>;
 					break;
-				
+
 				case 5:
 					// j(b-d)(M-m) - AND3 X, Y
-					and_trints(*trint_regs[mid_2], *trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint_pair<&CPU::and_trints>;
 					break;
-				
+
 				case 6:
 					// j(e-g)(M-m) - OR3 X, Y
-					or_trints(*trint_regs[mid_2], *trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint_pair<&CPU::or_trints>;
 					break;
-				
+
 				case 7:
 					// j(h-j)(M-m) - XOR3 X, Y
-					xor_trints(*trint_regs[mid_2], *trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint_pair<&CPU::xor_trints>;
 					break;
-				
+
 				case 8:
 					// j(k-m)(M-m) - SWAP3 X, Y
-					swap_trints(*trint_regs[mid_2], *trint_regs[low_2]);
-					break;
-				
-				default:
-					halt_and_catch_fire();
+					decoded.handler = &CPU::handle_trint_pair<&CPU::swap_trints>;
 					break;
 			}
 			break;
 
 		case 'k':
 			// kXY - miscellanous single Trint register
+			decoded.trint_x = trint_reg(low_2);
 			switch (second)
 			{
 				case 'b':
 				    // kbX - SET X, N
-					set_trint_to_num(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::set_trint_to_num>;
+					decoded.length = 4;
 					break;
 				case 'a':
 				    // kaX - ADD X, N
-					add_num_to_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::add_num_to_trint>;
+					decoded.length = 4;
 					break;
 				case 'c':
 					// kcX - CMP X, N
-					compare_trint_to_num(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::compare_trint_to_num>;
+					decoded.length = 4;
 					break;
 				case 'd':
 					// kdX - DIV X, N
-					div_trint_by_num(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::div_trint_by_num>;
+					decoded.length = 4;
 					break;
 				case 'e':
 					// keX - MUL X, N
-					mult_trint_by_num(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::mult_trint_by_num>;
+					decoded.length = 4;
 					break;
 				case 'f':
 					// kfX - AND X, N
-					and_trint_by_num(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::and_trint_by_num>;
+					decoded.length = 4;
 					break;
 				case 'g':
 					// kgX - OR X, N
-					or_trint_by_num(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::or_trint_by_num>;
+					decoded.length = 4;
 					break;
 				case 'h':
 					// khX - XOR X, N
-					xor_trint_by_num(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::xor_trint_by_num>;
+					decoded.length = 4;
 					break;
 				case 'i':
 					// kiX - INC X
-					inc_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::inc_trint>;
 					break;
 				case 'I':
 					// kIX - DEC X
-					dec_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::dec_trint>;
 					break;
 				case 'A':
 					// kAX - ABS X
-					abs_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::abs_trint>;
 					break;
 				case 'B':
 					// kBX - NOT X
-					not_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::not_trint>;
 					break;
 				case '0':
 					// k0X - FLIP X
-					flip_trint(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::flip_trint>;
 					break;
 				case 'm':
 					// kmX - SHL X, n
-					shift_trint_left(*trint_regs[low_2]);
+					decoded.handler = &CPU::handle_trint<&CPU::shift_trint_left>;
+					decoded.length = 2;
 					break;
 				case 'M':
 					// kMX - SHR X, n
-					shift_trint_right(*trint_regs[low_2]);
-					break;
-				default:
-					halt_and_catch_fire();
+					decoded.handler = &CPU::handle_trint<&CPU::shift_trint_right>;
+					decoded.length = 2;
 					break;
 			}
 			break;
 
 		case 'K':
 			// Kxy - Tryte register & constant
+			decoded.x = tryte_reg(low_3);
 			switch (second)
 			{
 				case 'a':
 				    // KaX - ADD X, N
-					add_num_to_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::add_num_to_tryte>;
+					decoded.length = 2;
 					break;
 				case 'b':
 				    // KbX - SET X, N
-					set_tryte_to_num(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::set_tryte_to_num>;
+					decoded.length = 2;
 					break;
 				case 'c':
 					// KcX - CMP X, N
-					compare_tryte_to_num(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::compare_tryte_to_num>;
+					decoded.length = 2;
 					break;
 				case 'd':
 					// KdX - DIV X, N
-					div_tryte_by_num(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::div_tryte_by_num>;
+					decoded.length = 2;
 					break;
 				case 'e':
 					// KeX - MUL X, N
-					mult_tryte_by_num(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::mult_tryte_by_num>;
+					decoded.length = 2;
 					break;
 				case 'f':
 					// KfX - AND X, N
-					and_tryte_by_num(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::and_tryte_by_num>;
+					decoded.length = 2;
 					break;
 				case 'g':
 					// KgX - OR X, N
-					or_tryte_by_num(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::or_tryte_by_num>;
+					decoded.length = 2;
 					break;
 				case 'h':
 					// KhX - XOR X, N
-					xor_tryte_by_num(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::xor_tryte_by_num>;
+					decoded.length = 2;
 					break;
 				case 'i':
 					// KiX - INC X
-					inc_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::inc_tryte>;
 					break;
 				case 'I':
 					// KIX - DEC X
-					dec_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::dec_tryte>;
 					break;
 				case 'A':
 					// KAX - ABS X
-					abs_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::abs_tryte>;
 					break;
 				case 'B':
 					// KBX - NOT X
-					not_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::not_tryte>;
 					break;
 				case '0':
 					// K0X - FLIP X
-					flip_tryte(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::flip_tryte>;
 					break;
 				case 'm':
 					// KmX - SHL X, n
-					shift_tryte_left(*tryte_regs[third]);
+					decoded.handler = &CPU::handle_tryte<&CPU::shift_tryte_left>;
+					decoded.length = 2;
 					break;
-				
 				case 'M':
 					// KMX - SHR X, n
-					shift_tryte_right(*tryte_regs[third]);
-					break;
-				
-				default:
-					halt_and_catch_fire();
+					decoded.handler = &CPU::handle_tryte<&CPU::shift_tryte_right>;
+					decoded.length = 2;
 					break;
 			}
 			break;
+	}
 
-		default:
-			halt_and_catch_fire();
-			break;
+	// control flow, memory writes and FPU instructions (which may push or write floats)
+	// all end a cached block
+	decoded.ends_block = first == '0' or first == 'f' or first == 'g' or first == 'd'
+		or (first == 'a' and second != 'A' and second != 'a' and second != 'm')
+		or (first == 'b' and (second == 'A' or second == 'a'))
+		or decoded.handler == &CPU::handle<&CPU::halt_and_catch_fire>;
+
+	return decoded;
+}
+
+Tryte* CPU::tryte_reg(int16_t digit)
+{
+	return &_regs[(digit + 13) / 3][(digit + 13) % 3];
+}
+Trint<3>* CPU::trint_reg(int16_t n)
+{
+	return &_regs[n];
+}
+
+void CPU::run_block()
+{
+	size_t index = Tryte::get_int(_i_ptr) + 9841;
+	std::vector<BlockOp>& block = _block_cache[index];
+	if (block.empty() or !block_is_valid(block))
+	{
+		if (_jit)
+		{
+			// any compiled code is for the old block
+			_jit_blocks[index] = { 0, nullptr };
+		}
+		record_block(block);
+		return;
+	}
+
+	if (_jit)
+	{
+		JitBlock& jit_block = _jit_blocks[index];
+		if (jit_block.code == nullptr and ++jit_block.executions == _jit_threshold)
+		{
+			jit_block.code = compile_block(block);
+		}
+		if (jit_block.code != nullptr)
+		{
+			jit_block.code();
+			if (_jit_exception != nullptr)
+			{
+				// as if the handler had thrown it here
+				std::exception_ptr exception = _jit_exception;
+				_jit_exception = nullptr;
+				_on = true;
+				std::rethrow_exception(exception);
+			}
+			return;
+		}
+	}
+
+	for (BlockOp const& op : block)
+	{
+		if (op.fused != nullptr)
+		{
+			// the compare and jump that end the block
+			_instr = (&op + 1)->instr;
+			op.fused(*this, *op.decoded);
+			_clock += 2;
+			return;
+		}
+		_instr = op.instr;
+		op.decoded->handler(*this, *op.decoded);
+		_clock += 1;
+		// leave the block as soon as execution doesn't fall through to the next op
+		if (!_on or _i_ptr != op.next)
+		{
+			return;
+		}
+	}
+}
+void CPU::record_block(std::vector<BlockOp>& block)
+{
+	block.clear();
+	bool recording = true;
+	while (recording)
+	{
+		Tryte addr = _i_ptr;
+		fetch();
+		DecodedInstr const& decoded = _decode_table[Tryte::get_int(_instr) + 9841];
+		decoded.handler(*this, decoded);
+		_clock += 1;
+		block.push_back({ &decoded, _instr, addr, _i_ptr, nullptr });
+		recording = _on and !decoded.ends_block and block.size() < _max_block_size;
+	}
+	fuse_block(block);
+}
+void CPU::fuse_block(std::vector<BlockOp>& block)
+{
+	if (block.size() < 2)
+	{
+		return;
+	}
+	BlockOp& compare = block[block.size() - 2];
+	auto compare_handler = compare.decoded->handler;
+	auto jump_handler = block.back().decoded->handler;
+	if (compare_handler != &CPU::handle_tryte_pair<&CPU::compare_trytes>
+		and compare_handler != &CPU::handle_tryte<&CPU::compare_tryte_to_num>
+		and compare_handler != &CPU::handle_trint_pair<&CPU::compare_trints>
+		and compare_handler != &CPU::handle_trint<&CPU::compare_trint_to_num>)
+	{
+		return;
+	}
+
+	if (jump_handler == &CPU::handle<&CPU::jump_if_zero>)
+	{
+		compare.fused = &CPU::handle_compare_and_jump<0>;
+	}
+	else if (jump_handler == &CPU::handle<&CPU::jump_if_neg>)
+	{
+		compare.fused = &CPU::handle_compare_and_jump<-1>;
+	}
+	else if (jump_handler == &CPU::handle<&CPU::jump_if_pos>)
+	{
+		compare.fused = &CPU::handle_compare_and_jump<1>;
+	}
+}
+bool CPU::block_is_valid(std::vector<BlockOp> const& block)
+{
+	for (BlockOp const& op : block)
+	{
+		if (_memory.load(op.addr) != op.instr)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+Jit::Code CPU::compile_block(std::vector<BlockOp> const& block)
+{
+	// the compiled code works on the raw values inside these
+	static_assert(sizeof(Tryte) == sizeof(int16_t), "Tryte must be a bare int16_t");
+	static_assert(sizeof(Trint<3>) == 3 * sizeof(int16_t), "Trint<3> must be three bare Trytes");
+	static_assert(sizeof(std::atomic<bool>) == 1, "std::atomic<bool> must be a single byte");
+	static_assert(sizeof(size_t) == sizeof(uint64_t), "clock must be 64 bits");
+
+	JitCompiler(*this, *_jit, block).compile();
+	Jit::Code code = _jit->install();
+	if (code == nullptr)
+	{
+		// out of room - throw everything away and start again
+		_jit->reset();
+		for (JitBlock& jit_block : _jit_blocks)
+		{
+			jit_block = { 0, nullptr };
+		}
+		code = _jit->install();
+	}
+	return code;
+}
+void CPU::jit_call(CPU& cpu, BlockOp const& op)
+{
+	try
+	{
+		if (op.fused != nullptr)
+		{
+			op.fused(cpu, *op.decoded);
+		}
+		else
+		{
+			op.decoded->handler(cpu, *op.decoded);
+		}
+	}
+	catch (...)
+	{
+		// the compiled code leaves the block as the CPU is off
+		cpu._jit_exception = std::current_exception();
+		cpu._on = false;
 	}
 }
 
@@ -608,53 +954,42 @@ OPERATIONS
 // read/write 
 void CPU::read_tryte(Tryte& y)
 {
-	Tryte const& add_x = _memory[_i_ptr + 1];
-	y = _memory[add_x];
+	Tryte add_x = _memory.load(_i_ptr + 1);
+	y = _memory.load(add_x);
 	_i_ptr += 2;
 }
 void CPU::read_trint(Trint<3>& y)
 {
-	Tryte& add_x = _memory[_i_ptr + 1];
-	std::array<Tryte, 3> memory_trytes = { _memory[add_x], _memory[add_x + 1], _memory[add_x + 2] };
+	Tryte add_x = _memory.load(_i_ptr + 1);
+	std::array<Tryte, 3> memory_trytes = { _memory.load(add_x), _memory.load(add_x + 1), _memory.load(add_x + 2) };
 	y = Trint<3>(memory_trytes);
 	_i_ptr += 2;
 }
 void CPU::write_tryte(Tryte& x)
 {
-	Tryte& add_y = _memory[_i_ptr + 1];
-	_memory[add_y] = x;
+	Tryte add_y = _memory.load(_i_ptr + 1);
+	_memory.store(add_y, x);
 	_i_ptr += 2;
 }
 void CPU::write_trint(Trint<3>& x)
 {
-	Tryte& add_x = _memory[_i_ptr + 1];
-	_memory[add_x] = x[0];
-	_memory[add_x + 1] = x[1];
-	_memory[add_x + 2] = x[2];
+	Tryte add_x = _memory.load(_i_ptr + 1);
+	_memory.store(add_x, x[0]);
+	_memory.store(add_x + 1, x[1]);
+	_memory.store(add_x + 2, x[2]);
 	_i_ptr += 2;
 }
 void CPU::load()
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	// disk address is converted from Tryte to an int between 0 and 19682
-	int16_t disk_add_x = Tryte::get_int(_memory[_i_ptr + 1]) + 9841;
-	int16_t n = Tryte::get_int(_memory[_i_ptr + 2]);
-	Tryte& add_y = _memory[_i_ptr + 3];
-
-	Tryte temp;
-	std::string diskname = _disknames[_disk_num];
-	std::fstream disk(diskname);
+	int16_t disk_add_x = Tryte::get_int(_memory.load(_i_ptr + 1)) + 9841;
+	int16_t n = Tryte::get_int(_memory.load(_i_ptr + 2));
+	Tryte add_y = _memory.load(_i_ptr + 3);
 
 	if (n > 0)
 	{
-		size_t n_unsigned = n;
-		// seek to required point in file
-		disk.seekg(4 * static_cast<int>(disk_add_x));
-		// now start copying
-		for (size_t i = 0; i < n_unsigned; i++)
-		{
-			disk >> temp;
-			_memory[add_y + i] = temp;
-		}
+		_disks.mounted().load(disk_add_x, n, _memory, add_y);
 	}
 	else
 	{
@@ -664,25 +999,14 @@ void CPU::load()
 }
 void CPU::save()
 {
-	Tryte& add_x = _memory[_i_ptr + 1];
-	size_t n = Tryte::get_int(_memory[_i_ptr + 2]) + 9841;
-	int16_t disk_add_y = Tryte::get_int(_memory[_i_ptr + 3]) + 9841;
-
-	std::string diskname = _disknames[_disk_num];
-	std::fstream disk(diskname);
-	Tryte temp;
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	Tryte add_x = _memory.load(_i_ptr + 1);
+	size_t n = Tryte::get_int(_memory.load(_i_ptr + 2)) + 9841;
+	int16_t disk_add_y = Tryte::get_int(_memory.load(_i_ptr + 3)) + 9841;
 
 	if (n > 0)
 	{
-		// seek to required point in file
-		disk.seekg(4 * static_cast<int>(disk_add_y));
-		// now start copying
-		for (size_t i = 0; i < n; i++)
-		{
-			temp = _memory[add_x + i];
-			disk << temp; // overwrite data on disk
-			disk << " ";
-		}
+		_disks.mounted().save(_memory, add_x, n, disk_add_y);
 	}
 	else
 	{
@@ -692,26 +1016,31 @@ void CPU::save()
 }
 void CPU::print()
 {
-	size_t n = Tryte::get_int(_memory[_i_ptr + 1]) + 9841;
-	Tryte& add_x = _memory[_i_ptr + 2];
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	size_t n = Tryte::get_int(_memory.load(_i_ptr + 1)) + 9841;
+	Tryte add_x = _memory.load(_i_ptr + 2);
 	for (size_t i = 0; i < n; i++)
 	{
-		_console << _memory[add_x + i];
+		Tryte t = _memory.load(add_x + i);
+		_console << t;
 	}
 	_i_ptr += 3;
 }
 void CPU::show_tryte(Tryte& a)
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	_console << a;
 	_i_ptr += 1;
 }
 void CPU::show_trint(Trint<3>& a)
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	_console << a;
 	_i_ptr += 1;
 }
 void CPU::tell_tryte(Tryte& a)
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	char c[2] = { 0, 0 };
 	_console >> c[0] >> c[1];
 	int16_t tryte_value = 128 * static_cast<int16_t>(c[0]) + static_cast<int16_t>(c[1]) - 9841;
@@ -720,6 +1049,7 @@ void CPU::tell_tryte(Tryte& a)
 }
 void CPU::tell_trint(Trint<3>& a)
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	char c[2] = { 0, 0 };
 	for (size_t i = 0; i < 3; i++)
 	{
@@ -731,40 +1061,36 @@ void CPU::tell_trint(Trint<3>& a)
 }
 void CPU::peek_tryte(Tryte& a)
 {
-	a = _memory[_s_ptr - 1];
+	a = _memory.load(_s_ptr - 1);
 	_i_ptr += 1;
 }
 void CPU::peek_trint(Trint<3>& a)
 {
-	std::array<Tryte, 3> stack_trytes = { _memory[_s_ptr - 1], _memory[_s_ptr - 2], _memory[_s_ptr - 3] };
+	std::array<Tryte, 3> stack_trytes = { _memory.load(_s_ptr - 1), _memory.load(_s_ptr - 2), _memory.load(_s_ptr - 3) };
 	a = Trint<3>(stack_trytes);
 	_i_ptr += 1;
 }
 void CPU::fill()
 {
-	Tryte& add_x = _memory[_i_ptr + 1];
-	size_t n = Tryte::get_int(_memory[_i_ptr + 2]) + 9841;
-	Tryte k = _memory[_i_ptr + 3];
+	Tryte add_x = _memory.load(_i_ptr + 1);
+	size_t n = Tryte::get_int(_memory.load(_i_ptr + 2)) + 9841;
+	Tryte k = _memory.load(_i_ptr + 3);
 	for (size_t i = 0; i < n; i++)
 	{
-		_memory[add_x + i] = k;
+		_memory.store(add_x + i, k);
 	}
 	_i_ptr += 4;
 }
 void CPU::mount(size_t n)
 {
-	if (n < _disknames.size())
-	{
-		_disk_num = n;
-	}
-	else
-	{
-		throw std::runtime_error("Tried to mount a disk that doesn't exist.\n");
-	}
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	// disks are all open already - this just switches between them (flushing the old one)
+	_disks.mount(n);
 	_i_ptr += 1;
 }
 void CPU::set_display_mode(Tryte& a)
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	std::array<int16_t, 3> a_array = Tryte::septavingt_array(a);
 	int16_t last_digit = a_array[2] + 13;
 	switch (last_digit)
@@ -785,7 +1111,7 @@ void CPU::set_display_mode(Tryte& a)
 			_console.wide_text_mode();
 			break;
 		case 5:
-			_console.graphics_mode();
+			graphics_mode();
 			break;
 		default:
 			throw std::runtime_error("Unrecognised display mode.\n");
@@ -795,6 +1121,7 @@ void CPU::set_display_mode(Tryte& a)
 }
 void CPU::set_display_mode(Trint<3>& a)
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	int16_t last_digit = Tryte::septavingt_array(a[2])[2] + 13;
 	switch (last_digit)
 	{
@@ -814,7 +1141,7 @@ void CPU::set_display_mode(Trint<3>& a)
 			_console.wide_text_mode();
 			break;
 		case 5:
-			_console.graphics_mode();
+			graphics_mode();
 			break;
 		default:
 			throw std::runtime_error("Unrecognised display mode.\n");
@@ -824,6 +1151,7 @@ void CPU::set_display_mode(Trint<3>& a)
 }
 void CPU::set_display_mode(size_t n)
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	switch (n)
 	{
 		case 0:
@@ -842,7 +1170,7 @@ void CPU::set_display_mode(size_t n)
 			_console.wide_text_mode();
 			break;
 		case 5:
-			_console.graphics_mode();
+			graphics_mode();
 			break;
 		default:
 			throw std::runtime_error("Unrecognised display mode.\n");
@@ -850,39 +1178,49 @@ void CPU::set_display_mode(size_t n)
 	}
 	_i_ptr += 1;
 }
+void CPU::graphics_mode()
+{
+	_console.graphics_mode();
+	if (_devices->display == nullptr)
+	{
+		_devices->display = std::make_unique<Display>(_memory, _console, _devices->mutex, _devices->frame_rate);
+	}
+}
 void CPU::get_display_mode(Tryte& a)
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	a = _console.get_output_mode() - 13;
 	_i_ptr += 1;
 }
 void CPU::get_display_mode(Trint<3>& a)
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	a = _console.get_output_mode() - 13;
 	_i_ptr += 1;
 }
 void CPU::push_tryte(Tryte& a)
 {
-	_memory[_s_ptr] = a;
+	_memory.store(_s_ptr, a);
 	_s_ptr += 1;
 	_i_ptr += 1;
 }
 void CPU::push_trint(Trint<3>& a)
 {
-	_memory[_s_ptr] = a[0];
-	_memory[_s_ptr + 1] = a[1];
-	_memory[_s_ptr + 2] = a[2];
+	_memory.store(_s_ptr, a[0]);
+	_memory.store(_s_ptr + 1, a[1]);
+	_memory.store(_s_ptr + 2, a[2]);
 	_s_ptr += 3;
 	_i_ptr += 1;
 }
 void CPU::pop_tryte(Tryte& a)
 {
-	a = _memory[_s_ptr - 1];
+	a = _memory.load(_s_ptr - 1);
 	_s_ptr -= 1;
 	_i_ptr += 1;
 }
 void CPU::pop_trint(Trint<3>& a)
 {
-	std::array<Tryte, 3> stack_trytes = { _memory[_s_ptr - 3], _memory[_s_ptr - 2], _memory[_s_ptr - 1] };
+	std::array<Tryte, 3> stack_trytes = { _memory.load(_s_ptr - 3), _memory.load(_s_ptr - 2), _memory.load(_s_ptr - 1) };
 	a = Trint<3>(stack_trytes);
 	_s_ptr -= 3;
 	_i_ptr += 1;
@@ -896,15 +1234,15 @@ void CPU::where(Tryte& x)
 // register handling
 void CPU::set_trint_to_num(Trint<3>& a)
 {
-	std::array<Tryte, 3> new_trint_array = { _memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3] };
+	std::array<Tryte, 3> new_trint_array = { _memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3) };
 	Trint<3> new_trint(new_trint_array);
 	a = new_trint;
 	_i_ptr += 4;
 }
 void CPU::set_trint_to_addr(Trint<3>& a)
 {
-	Tryte& add_x = _memory[_i_ptr + 1];
-	std::array<Tryte, 3> new_trint_array = { _memory[add_x], _memory[add_x + 1], _memory[add_x + 2] };
+	Tryte add_x = _memory.load(_i_ptr + 1);
+	std::array<Tryte, 3> new_trint_array = { _memory.load(add_x), _memory.load(add_x + 1), _memory.load(add_x + 2) };
 	Trint<3> new_trint(new_trint_array);
 	a = new_trint;
 	_i_ptr += 2;
@@ -916,13 +1254,13 @@ void CPU::set_trint(Trint<3>& a, Trint<3>& y)
 }
 void CPU::set_tryte_to_num(Tryte& a)
 {
-	a = _memory[_i_ptr + 1];
+	a = _memory.load(_i_ptr + 1);
 	_i_ptr += 2;
 }
 void CPU::set_tryte_to_addr(Tryte& a)
 {
-	Tryte& add_x = _memory[_i_ptr + 1];
-	a = _memory[add_x];
+	Tryte add_x = _memory.load(_i_ptr + 1);
+	a = _memory.load(add_x);
 	_i_ptr += 2;
 }
 void CPU::set_tryte(Tryte& a, Tryte& y)
@@ -948,32 +1286,57 @@ void CPU::swap_trytes(Tryte& a, Tryte& b)
 // flag handling
 void CPU::clear_compare()
 {
-	_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0"));
+	_flags.compare = 0;
 	_i_ptr += 1;
 }
 void CPU::clear_carry()
 {
-	_flags = Tryte::tritwise_mult(_flags, Tryte("+++++++0+"));
+	_flags.carry = 0;
 	_i_ptr += 1;
 }
 void CPU::clear_overflow()
 {
-	_flags = Tryte::tritwise_mult(_flags, Tryte("++++++0++"));
+	_flags.overflow = 0;
 	_i_ptr += 1;
 }
+void CPU::set_overflow()
+{
+	_flags.overflow = 1;
+}
+template <typename T>
+int16_t CPU::compare_sign(T const& x, T const& y)
+{
+	return x < y ? -1 : (y < x ? 1 : 0);
+}
+int16_t CPU::compare_sign(DecodedInstr const& decoded)
+{
+	// the operands the compare was decoded with tell which CMP it is
+	if (decoded.trint_x != nullptr)
+	{
+		if (decoded.trint_y != nullptr)
+		{
+			return compare_sign(*decoded.trint_x, *decoded.trint_y);
+		}
+		std::array<Tryte, 3> num_array = { _memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3) };
+		return compare_sign(*decoded.trint_x, Trint<3>(num_array));
+	}
+	if (decoded.y != nullptr)
+	{
+		return compare_sign(*decoded.x, *decoded.y);
+	}
+	return compare_sign(*decoded.x, _memory.load(_i_ptr + 1));
+}
 void CPU::set_priority(int16_t n)
 {
-	_flags = Tryte::tritwise_mult(_flags, Tryte("+++000+++"));
-	_flags += (27 * n);
+	_flags.current_priority = n;
 	_i_ptr += 1;
 }
 void CPU::check_priority()
 {
-	int16_t stored_priority = Tryte::get_int((_flags >> 6));
-	int16_t current_priority = Tryte::get_int(Tryte::tritwise_mult(_flags, Tryte("000+++000")) >> 3);
-	if (stored_priority > current_priority)
+	take_pending_interrupt();
+	if (_flags.stored_priority > _flags.current_priority)
 	{
-		switch_thread(stored_priority);
+		enter_interrupt(_flags.stored_priority);
 	}
 	else
 	{
@@ -1014,26 +1377,18 @@ void CPU::dec_trint(Trint<3>& x)
 }
 void CPU::add_trytes(Tryte& x, Tryte& y)
 {
-	std::array<Tryte, 2> temp = Tryte::add_with_carry(x, y, Tryte("000"));
+	std::array<Tryte, 2> temp = Tryte::add_with_carry(x, y, Tryte(0));
 	x = temp[1];
 	// Y is overwritten with the carry.
 	y = temp[0];
 	// set carry flag
-	_flags = Tryte::tritwise_mult(_flags, Tryte("mmj"));
-	if (y > 0)
-	{
-		_flags += 3;
-	}
-	else if (y < 0)
-	{
-		_flags -= 3;
-	}
+	_flags.carry = compare_sign(y, Tryte(0));
 	_i_ptr += 1;
 }
 void CPU::add_num_to_tryte(Tryte& x)
 {
-	Tryte num = _memory[_i_ptr + 1];
-	x = Tryte::add_with_carry(x, num, Tryte("000"))[1];
+	Tryte num = _memory.load(_i_ptr + 1);
+	x = Tryte::add_with_carry(x, num, Tryte(0))[1];
 	_i_ptr += 2;
 }
 void CPU::add_trints(Trint<3>& x, Trint<3>& y)
@@ -1043,7 +1398,7 @@ void CPU::add_trints(Trint<3>& x, Trint<3>& y)
 }
 void CPU::add_num_to_trint(Trint<3>& x)
 {
-	std::array<Tryte, 3> new_trint_array = { _memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3] };
+	std::array<Tryte, 3> new_trint_array = { _memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3) };
 	Trint<3> num(new_trint_array);
 	x += num;
 	_i_ptr += 4;
@@ -1055,20 +1410,12 @@ void CPU::mult_trytes(Tryte& x, Tryte& y)
 	// Y is overwritten with the carry.
 	y = temp[0];
 	// set carry flag
-	_flags = Tryte::tritwise_mult(_flags, Tryte("mmj"));
-	if (y > 0)
-	{
-		_flags += 3;
-	}
-	else if (y < 0)
-	{
-		_flags -= 3;
-	}
+	_flags.carry = compare_sign(y, Tryte(0));
 	_i_ptr += 1;
 }
 void CPU::mult_tryte_by_num(Tryte& x)
 {
-	Tryte num = _memory[_i_ptr + 1];
+	Tryte num = _memory.load(_i_ptr + 1);
 	x = Tryte::mult(x, num)[1];
 	_i_ptr += 2;
 }
@@ -1079,102 +1426,95 @@ void CPU::mult_trints(Trint<3>& x, Trint<3>& y)
 }
 void CPU::mult_trint_by_num(Trint<3>& x)
 {
-	std::array<Tryte, 3> new_trint_array = { _memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3] };
+	std::array<Tryte, 3> new_trint_array = { _memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3) };
 	Trint<3> num(new_trint_array);
 	x *= num;
 	_i_ptr += 4;
 }
 void CPU::div_trytes(Tryte& x, Tryte& y)
 {
-	try
+	std::array<Tryte, 2> div_result;
+	if (Tryte::try_div(x, y, div_result))
 	{
-		std::array<Tryte, 2> div_result = Tryte::div(x, y);
 		x = div_result[0];
 		y = div_result[1];
-		_i_ptr += 1;
 	}
-	catch(const std::runtime_error& e)
+	else
 	{
 		// divide by zero - set overflow flag and go to next operation
-		_flags = Tryte::tritwise_mult(_flags, Tryte("mmd"));
-		_flags += 9;
-		_i_ptr += 1;
+		set_overflow();
 	}
+	_i_ptr += 1;
 }
 void CPU::div_tryte_by_num(Tryte& x)
 {
-	Tryte num = _memory[_i_ptr + 1];
+	Tryte num = _memory.load(_i_ptr + 1);
 
-	try
+	std::array<Tryte, 2> div_result;
+	if (Tryte::try_div(x, num, div_result))
 	{
-		std::array<Tryte, 2> div_result = Tryte::div(x, num);
 		x = div_result[0];
-		_i_ptr += 2;
 	}
-	catch(const std::runtime_error& e)
+	else
 	{
 		// divide by zero - set overflow flag and go to next operation
-		_flags = Tryte::tritwise_mult(_flags, Tryte("mmd"));
-		_flags += 9;
-		_i_ptr += 2;
+		set_overflow();
 	}
+	_i_ptr += 2;
 }
 void CPU::div_trints(Trint<3>& x, Trint<3>& y)
 {
-	try
+	std::array<Trint<3>, 2> div_result;
+	if (Trint<3>::try_div(x, y, div_result))
 	{
-		std::array<Trint<3>, 2> div_result = Trint<3>::div(x, y);
 		x = div_result[0];
 		y = div_result[1];
-		_i_ptr += 1;
 	}
-	catch(const std::runtime_error& e)
+	else
 	{
 		// divide by zero - set overflow flag and go to next operation
-		_flags = Tryte::tritwise_mult(_flags, Tryte("mmd"));
-		_flags += 9;
-		_i_ptr += 1;
+		set_overflow();
 	}
+	_i_ptr += 1;
 }
 void CPU::div_trint_by_num(Trint<3>& x)
 {
-	std::array<Tryte, 3> new_trint_array = { _memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3] };
+	std::array<Tryte, 3> new_trint_array = { _memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3) };
 	Trint<3> num(new_trint_array);
-	try
+
+	std::array<Trint<3>, 2> div_result;
+	if (Trint<3>::try_div(x, num, div_result))
 	{
-		std::array<Trint<3>, 2> div_result = Trint<3>::div(x, num);
 		x = div_result[0];
-		_i_ptr += 4;
 	}
-	catch(const std::runtime_error& e)
+	else
 	{
 		// divide by zero - set overflow flag and go to next operation
-		_flags = Tryte::tritwise_mult(_flags, Tryte("mmd"));
-		_flags += 9;
-		_i_ptr += 4;
+		set_overflow();
 	}
+	_i_ptr += 4;
 }
 void CPU::shift_tryte_left(Tryte& x)
 {
-	size_t n = Tryte::get_int(_memory[_i_ptr + 1]) + 9841;
+	size_t n = Tryte::get_int(_memory.load(_i_ptr + 1)) + 9841;
 	x << n;
 	_i_ptr += 2;
 }
 void CPU::shift_trint_left(Trint<3>& x)
 {
-	size_t n = Tryte::get_int(_memory[_i_ptr + 1]) + 9841;
+	size_t n = Tryte::get_int(_memory.load(_i_ptr + 1)) + 9841;
 	x << n;
 	_i_ptr += 2;
 }
 void CPU::shift_tryte_right(Tryte& x)
 {
-	size_t n = Tryte::get_int(_memory[_i_ptr + 1]) + 9841;
+	size_t n = Tryte::get_int(_memory.load(_i_ptr + 1)) + 9841;
 	x >> n;
 	_i_ptr += 2;
 }
 void CPU::shift_trint_right(Trint<3>& x)
 {
-	size_t n = Tryte::get_int(_memory[_i_ptr + 1]) + 9841;
+	size_t n = Tryte::get_int(_memory.load(_i_ptr + 1)) + 9841;
 	x >> n;
 	_i_ptr += 2;
 }
@@ -1182,70 +1522,24 @@ void CPU::shift_trint_right(Trint<3>& x)
 // comparison
 void CPU::compare_trytes(Tryte& x, Tryte& y)
 {
-	if (x < y)
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) - 1;
-	}
-	else if (x > y)
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) + 1;
-	}
-	else
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0"));
-	}
+	_flags.compare = compare_sign(x, y);
 	_i_ptr += 1;
 }
 void CPU::compare_tryte_to_num(Tryte& x)
 {
-	Tryte num = _memory[_i_ptr + 1];
-	if (x < num)
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) - 1;
-	}
-	else if (x > num)
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) + 1;
-	}
-	else
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0"));
-	}
+	_flags.compare = compare_sign(x, _memory.load(_i_ptr + 1));
 	_i_ptr += 2;
 }
 void CPU::compare_trints(Trint<3>& x, Trint<3>& y)
 {
-	if (x < y)
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) - 1;
-	}
-	else if (x > y)
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) + 1;
-	}
-	else
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0"));
-	}
+	_flags.compare = compare_sign(x, y);
 	_i_ptr += 1;
 }
 void CPU::compare_trint_to_num(Trint<3>& x)
 {
-	std::array<Tryte, 3> new_trint_array = { _memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3] };
+	std::array<Tryte, 3> new_trint_array = { _memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3) };
 	Trint<3> num(new_trint_array);
-
-	if (x < num)
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) - 1;
-	}
-	else if (x > num)
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) + 1;
-	}
-	else
-	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0"));
-	}
+	_flags.compare = compare_sign(x, num);
 	_i_ptr += 4;
 }
 
@@ -1257,7 +1551,7 @@ void CPU::and_trytes(Tryte& x, Tryte& y)
 }
 void CPU::and_tryte_by_num(Tryte& x)
 {
-	Tryte num = _memory[_i_ptr + 1];
+	Tryte num = _memory.load(_i_ptr + 1);
 	x &= num;
 	_i_ptr += 2;
 }
@@ -1268,7 +1562,7 @@ void CPU::and_trints(Trint<3>& x, Trint<3>& y)
 }
 void CPU::and_trint_by_num(Trint<3>& x)
 {
-	std::array<Tryte, 3> new_trint_array = { _memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3] };
+	std::array<Tryte, 3> new_trint_array = { _memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3) };
 	Trint<3> num(new_trint_array);
 
 	x &= num;
@@ -1281,7 +1575,7 @@ void CPU::or_trytes(Tryte& x, Tryte& y)
 }
 void CPU::or_tryte_by_num(Tryte& x)
 {
-	Tryte num = _memory[_i_ptr + 1];
+	Tryte num = _memory.load(_i_ptr + 1);
 	x |= num;
 	_i_ptr += 2;
 }
@@ -1292,7 +1586,7 @@ void CPU::or_trints(Trint<3>& x, Trint<3>& y)
 }
 void CPU::or_trint_by_num(Trint<3>& x)
 {
-	std::array<Tryte, 3> new_trint_array = { _memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3] };
+	std::array<Tryte, 3> new_trint_array = { _memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3) };
 	Trint<3> num(new_trint_array);
 
 	x |= num;
@@ -1305,7 +1599,7 @@ void CPU::xor_trytes(Tryte& x, Tryte& y)
 }
 void CPU::xor_tryte_by_num(Tryte& x)
 {
-	Tryte num = _memory[_i_ptr + 1];
+	Tryte num = _memory.load(_i_ptr + 1);
 	x ^= num;
 	_i_ptr += 2;
 }
@@ -1316,7 +1610,7 @@ void CPU::xor_trints(Trint<3>& x, Trint<3>& y)
 }
 void CPU::xor_trint_by_num(Trint<3>& x)
 {
-	std::array<Tryte, 3> new_trint_array = { _memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3] };
+	std::array<Tryte, 3> new_trint_array = { _memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3) };
 	Trint<3> num(new_trint_array);
 
 	x ^= num;
@@ -1350,10 +1644,9 @@ void CPU::noop()
 }
 void CPU::jump_if_zero()
 {
-	int16_t compare_flag = Tryte::get_int(Tryte::tritwise_mult(_flags, Tryte("00000000+")));
-	if (compare_flag == 0)
+	if (_flags.compare == 0)
 	{
-		_i_ptr = _memory[_i_ptr + 1];
+		_i_ptr = _memory.load(_i_ptr + 1);
 	}
 	else
 	{
@@ -1362,10 +1655,9 @@ void CPU::jump_if_zero()
 }
 void CPU::jump_if_neg()
 {
-	int16_t compare_flag = Tryte::get_int(Tryte::tritwise_mult(_flags, Tryte("00000000+")));
-	if (compare_flag < 0)
+	if (_flags.compare < 0)
 	{
-		_i_ptr = _memory[_i_ptr + 1];
+		_i_ptr = _memory.load(_i_ptr + 1);
 	}
 	else
 	{
@@ -1374,10 +1666,9 @@ void CPU::jump_if_neg()
 }
 void CPU::jump_if_pos()
 {
-	int16_t compare_flag = Tryte::get_int(Tryte::tritwise_mult(_flags, Tryte("00000000+")));
-	if (compare_flag > 0)
+	if (_flags.compare > 0)
 	{
-		_i_ptr = _memory[_i_ptr + 1];
+		_i_ptr = _memory.load(_i_ptr + 1);
 	}
 	else
 	{
@@ -1386,114 +1677,498 @@ void CPU::jump_if_pos()
 }
 void CPU::jump()
 {
-	_i_ptr = _memory[_i_ptr + 1];
+	_i_ptr = _memory.load(_i_ptr + 1);
 }
 void CPU::jump_and_store()
 {
-	_memory[_s_ptr] = _i_ptr;
+	_memory.store(_s_ptr, _i_ptr);
 	_s_ptr += 1;
-	_i_ptr = _memory[_i_ptr + 1];
+	_i_ptr = _memory.load(_i_ptr + 1);
 }
 void CPU::pop_and_jump()
 {
-	Tryte temp = _memory[_s_ptr - 1];
+	Tryte temp = _memory.load(_s_ptr - 1);
 	_s_ptr -= 1;
-	_i_ptr = _memory[temp];
+	_i_ptr = _memory.load(temp);
 }
-void CPU::switch_thread(size_t n)
+void CPU::switch_thread(int16_t n)
 {
-	_i_ptr = _int_ptrs[n];
+	_i_ptr = _int_ptrs[n + 13];
 }
-void CPU::set_interrupt_ptr(size_t n)
+void CPU::set_interrupt_ptr(int16_t n)
 {
-	_int_ptrs[n] = _memory[_i_ptr + 1];
+	_int_ptrs[n + 13] = _memory.load(_i_ptr + 1);
 	_i_ptr += 2;
 }
 void CPU::wait()
 {
-	bool waiting = true;
-	int16_t current_priority = Tryte::get_int(Tryte::tritwise_mult(_flags, Tryte("000+++000")) >> 3);
-	while (waiting)
+	while (_on)
 	{
-		int16_t stored_priority = Tryte::get_int(_flags >> 6);
-		if (stored_priority > current_priority)
+		take_pending_interrupt();
+		if (_flags.stored_priority > _flags.current_priority)
 		{
-			switch_thread(stored_priority);
-			waiting = false;
+			enter_interrupt(_flags.stored_priority);
+			return;
 		}
-		else
+
+		if (_log != nullptr and _log->replaying())
 		{
-			_clock += 1;
-		}		
+			// no sleeping - the clock moves as far as it did when recorded. A log that ends here
+			// was recorded by a run switched off while it waited.
+			if (_log->finished())
+			{
+				_on = false;
+				return;
+			}
+			_clock += _log->expect(ReplayLog::Event::wait, _clock);
+			continue;
+		}
+
+		// sleep until the host raises an interrupt (or switches us off), then count the time
+		// spent asleep as clock ticks. Flush output first, so the user sees it while we wait.
+		{
+			std::lock_guard<std::mutex> lock(_devices->mutex);
+			_console.flush();
+		}
+		if (_log != nullptr)
+		{
+			_log->flush();
+		}
+		auto start = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> lock(_interrupt_mutex);
+			_interrupt_signal.wait(lock, [this]() { return _interrupt_pending or !_on; });
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		size_t ticks = _wait_ticks_per_us * std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+		if (_log != nullptr)
+		{
+			_log->record(ReplayLog::Event::wait, _clock, ticks);
+		}
+		_clock += ticks;
 	}
 }
 void CPU::halt_and_catch_fire()
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
 	_on = false;
+	_disks.flush();
+	if (_devices->display != nullptr)
+	{
+		_devices->display->finish();
+	}
+	_console.flush();
+	_i_ptr += 1;
+}
+void CPU::get_core(Tryte& x)
+{
+	x = Tryte(_core);
+	_i_ptr += 1;
+}
+void CPU::compare_and_swap(Tryte& x, Tryte& y)
+{
+	Tryte found = x;
+	if (_memory.compare_and_swap(_memory.load(_i_ptr + 1), found, y))
+	{
+		_flags.compare = 0;
+	}
+	else
+	{
+		_flags.compare = compare_sign(found, x);
+		x = found;
+	}
+	_i_ptr += 2;
+}
+void CPU::fetch_add(Tryte& x)
+{
+	x = _memory.fetch_add(_memory.load(_i_ptr + 1), x);
+	_i_ptr += 2;
+}
+void CPU::fence()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
 	_i_ptr += 1;
 }
 
 // public methods
-void CPU::boot()
+size_t CPU::boot()
 {
 	_on = true;
-	size_t i = 0;
-	Tryte temp;
-	std::fstream boot_disk(_disknames[0]);
-
-	while (boot_disk >> temp)
+	if (_core != 0)
 	{
-		_memory[i] = temp;
-		i += 1;
+		// the boot core has already loaded the program
+		return 0;
 	}
+	// mount the boot disk and copy it into memory, starting at address 0
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	_disks.mount(0);
+	return _disks.mounted().load(0, 9842, _memory, Tryte(0));
 }
 void CPU::run()
 {
+	if (_profiler)
+	{
+		run_profiled();
+		return;
+	}
 	while (_on)
 	{
-		fetch();
-		decode_and_execute();
-		_clock += 1;
+		if (!_aot_blocks.empty())
+		{
+			AotBlock block = _aot_blocks[Tryte::get_int(_i_ptr) + 9841];
+			if (block != nullptr and block(*this))
+			{
+				continue;
+			}
+		}
+		run_block();
 	}
 }
+void CPU::run_profiled()
+{
+	while (_on)
+	{
+		int16_t addr = Tryte::get_int(_i_ptr);
+		auto start = std::chrono::steady_clock::now();
+		step();
+		auto end = std::chrono::steady_clock::now();
+		_profiler->record(Tryte::get_int(_instr), addr, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+	_profiler->report(*_profile_output);
+}
 void CPU::step()
 {
 	fetch();
 	decode_and_execute();
 	_clock += 1;
 }
+void CPU::run_until(Tryte const& addr)
+{
+	while (_on and _i_ptr != addr)
+	{
+		step();
+	}
+}
+void CPU::resume()
+{
+	_on = true;
+}
 void CPU::switch_off()
 {
-	_on = false;
+	{
+		// take the lock so a CPU about to block in WAIT can't miss the wake-up
+		std::lock_guard<std::mutex> lock(_interrupt_mutex);
+		_on = false;
+	}
+	_interrupt_signal.notify_all();
 }
 bool CPU::is_on()
 {
 	return _on;
 }
+size_t CPU::clock() const
+{
+	return _clock;
+}
 void CPU::dump()
 {
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	take_pending_interrupt();
 	_console.raw_mode();
-	_console << "Next instruction: " << _memory[_i_ptr] << '\n';
+	Tryte next_instr = _memory.load(_i_ptr);
+	_console << "Next instruction: " << next_instr << '\n';
 	_console << "Integer registers:\n";
 	_console.number_mode();
-	_console << "a = " << _a << " b = " << _b << " c = " << _c << '\n';
-	_console << "d = " << _d << " e = " << _e << " g = " << _g << '\n';
-	_console << "h = " << _h << " i = " << _i << " j = " << _j << '\n';
+	_console << "a = " << _regs[0] << " b = " << _regs[1] << " c = " << _regs[2] << '\n';
+	_console << "d = " << _regs[3] << " e = " << _regs[4] << " g = " << _regs[5] << '\n';
+	_console << "h = " << _regs[6] << " i = " << _regs[7] << " j = " << _regs[8] << '\n';
 	_console.raw_mode();
 	_console << "i_ptr = " << _i_ptr << '\n';
 	_console << "s_ptr = " << _s_ptr << '\n';
 	_console.ternary_mode();
-	_console << "Flags: " << _flags << '\n';
+	Tryte flags = _flags.pack();
+	_console << "Flags: " << flags << '\n';
 	_FPU.dump();
 	_console << '\n';
 	_console.raw_mode();
+	// the debugger's prompt follows, straight to std::cout
+	_console.flush();
 }
 void CPU::set_interrupt_priority(int16_t n)
 {
-	// clear stored priority
-	_flags = Tryte::tritwise_mult(_flags, Tryte("000++++++"));
+	{
+		std::lock_guard<std::mutex> lock(_interrupt_mutex);
+		_pending_priority = n;
+		_interrupt_pending = true;
+	}
+	_interrupt_signal.notify_all();
+}
+void CPU::enter_interrupt(int16_t priority)
+{
+	// nothing stored (priority -13) until the next interrupt arrives
+	_flags.stored_priority = -13;
+	switch_thread(priority);
+}
+void CPU::enable_jit()
+{
+	if (!Jit::supported())
+	{
+		throw std::runtime_error("The JIT is only supported on x86-64.\n");
+	}
+	_jit = std::make_unique<Jit>(_jit_arena_size);
+	_jit_blocks.assign(19683, { 0, nullptr });
+}
+void CPU::enable_profiler(std::ostream& profile_output, std::string const& map_filename)
+{
+	_profiler = std::make_unique<Profiler>();
+	_profile_output = &profile_output;
+	if (!map_filename.empty())
+	{
+		_profiler->set_source_map(std::make_unique<SourceMap>(map_filename));
+	}
+}
+std::string const CPU::snapshot_header = std::string("TRISNAP") + '\x01';
+
+void CPU::save_snapshot(std::string const& filename)
+{
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+
+	// everything but memory and the clock, in snapshot order
+	std::vector<int16_t> state;
+	for (Trint<3> const& reg : _regs)
+	{
+		for (size_t i = 0; i < 3; i++)
+		{
+			state.push_back(Tryte::get_int(reg[i]));
+		}
+	}
+	state.push_back(Tryte::get_int(_i_ptr));
+	state.push_back(Tryte::get_int(_s_ptr));
+	state.push_back(Tryte::get_int(_instr));
+	for (Tryte const& int_ptr : _int_ptrs)
+	{
+		state.push_back(Tryte::get_int(int_ptr));
+	}
+	state.insert(state.end(), { _flags.stored_priority, _flags.current_priority, _flags.overflow, _flags.carry, _flags.compare });
+	state.push_back(_disks.mounted_number());
+	state.push_back(_console.get_output_mode());
+	for (size_t i = 0; i < 9; i++)
+	{
+		TFloat const& reg = _FPU.float_reg(i);
+		Trint<2> mantissa = TFloat::get_mantissa(reg);
+		state.insert(state.end(), { Tryte::get_int(TFloat::get_exponent(reg)[0]), Tryte::get_int(mantissa[0]), Tryte::get_int(mantissa[1]) });
+	}
+	uint64_t clock = _clock;
+
+	std::ofstream file(filename, std::ios::binary);
+	file.write(snapshot_header.data(), snapshot_header.size());
+	file.write(reinterpret_cast<char const*>(_memory.data()), 2 * 19683);
+	file.write(reinterpret_cast<char const*>(state.data()), 2 * state.size());
+	file.write(reinterpret_cast<char const*>(&clock), sizeof(clock));
+	if (!file)
+	{
+		throw std::runtime_error("Could not write snapshot " + filename + ".\n");
+	}
+}
+void CPU::restore_snapshot(std::string const& filename)
+{
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	std::ifstream file(filename, std::ios::binary);
+	std::string header(snapshot_header.size(), '\0');
+	if (!file.read(&header[0], header.size()) or header != snapshot_header)
+	{
+		throw std::runtime_error(filename + " is not a snapshot.\n");
+	}
+
+	// registers (27), pointers (3), thread pointers (27), flags (5), disk, console mode, floats (27)
+	std::vector<int16_t> memory(19683);
+	std::vector<int16_t> state(27 + 3 + 27 + 5 + 2 + 27);
+	uint64_t clock = 0;
+	file.read(reinterpret_cast<char*>(memory.data()), 2 * memory.size());
+	file.read(reinterpret_cast<char*>(state.data()), 2 * state.size());
+	file.read(reinterpret_cast<char*>(&clock), sizeof(clock));
+	if (!file or file.peek() != std::ifstream::traits_type::eof())
+	{
+		throw std::runtime_error("Snapshot " + filename + " is the wrong size.\n");
+	}
+	// nothing from a corrupt file should reach the CPU
+	for (int16_t value : memory)
+	{
+		if (value < -9841 or value > 9841)
+		{
+			throw std::runtime_error("Snapshot " + filename + " holds invalid Trytes.\n");
+		}
+	}
+	for (int16_t value : state)
+	{
+		if (value < -9841 or value > 9841)
+		{
+			throw std::runtime_error("Snapshot " + filename + " holds invalid Trytes.\n");
+		}
+	}
+	// the flags, disk and console mode must be ones the computer could have been left in
+	int16_t const* flags = state.data() + 27 + 3 + 27;
+	int16_t disk = flags[5];
+	int16_t output_mode = flags[6];
+	if (flags[0] < -13 or flags[0] > 13 or flags[1] < -13 or flags[1] > 13)
+	{
+		throw std::runtime_error("Snapshot " + filename + " holds an invalid interrupt priority.\n");
+	}
+	for (size_t i = 2; i < 5; i++)
+	{
+		if (flags[i] < -1 or flags[i] > 1)
+		{
+			throw std::runtime_error("Snapshot " + filename + " holds an invalid flag.\n");
+		}
+	}
+	if (disk < 0 or static_cast<size_t>(disk) >= _disks.size())
+	{
+		throw std::runtime_error("Snapshot " + filename + " has a disk mounted that doesn't exist.\n");
+	}
+	if (output_mode < 0 or output_mode > 5)
+	{
+		throw std::runtime_error("Snapshot " + filename + " holds an invalid console mode.\n");
+	}
+
+	// everything is checked, so a snapshot that is rejected changes nothing
+	_disks.mount(disk);
+	_console.set_output_mode(output_mode);
+	if (output_mode == 5)
+	{
+		graphics_mode();
+	}
+	int16_t const* next = state.data();
+	for (size_t i = 0; i < 19683; i++)
+	{
+		_memory.store(static_cast<int>(i) - 9841, Tryte(memory[i]));
+	}
+	for (Trint<3>& reg : _regs)
+	{
+		for (size_t i = 0; i < 3; i++)
+		{
+			reg[i] = Tryte(*next++);
+		}
+	}
+	_i_ptr = Tryte(*next++);
+	_s_ptr = Tryte(*next++);
+	_instr = Tryte(*next++);
+	for (Tryte& int_ptr : _int_ptrs)
+	{
+		int_ptr = Tryte(*next++);
+	}
+	_flags = { flags[0], flags[1], flags[2], flags[3], flags[4] };
+	next += 5 + 2;
+	for (size_t i = 0; i < 9; i++, next += 3)
+	{
+		_FPU.float_reg(i) = TFloat(Tryte(next[0]), Tryte(next[1]), Tryte(next[2]));
+	}
+	_clock = clock;
+	_on = true;
+}
+void CPU::redirect_console(std::ostream& output, std::istream& input)
+{
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	_console.redirect(output, input);
+	if (_devices->display != nullptr)
+	{
+		// the new output hasn't seen any frames
+		_devices->display->clear();
+	}
+}
+void CPU::pause_display()
+{
+	// not under the device lock, which the frame thread needs to finish its frame
+	if (_devices->display != nullptr)
+	{
+		_devices->display->stop();
+	}
+}
+void CPU::resume_display()
+{
+	if (_devices->display != nullptr)
+	{
+		_devices->display->start();
+	}
+}
+void CPU::set_console_buffer_size(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	_console.set_buffer_size(bytes);
+}
+void CPU::set_frame_rate(unsigned frame_rate)
+{
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	_devices->frame_rate = frame_rate;
+}
+void CPU::flush_console()
+{
+	std::lock_guard<std::mutex> lock(_devices->mutex);
+	_console.flush();
+}
+void CPU::enable_async_input(int16_t n)
+{
+	_input = std::make_unique<InputDevice>(STDIN_FILENO, [this, n]() { set_interrupt_priority(n); });
+	_console.attach_input(_input.get());
+}
+void CPU::record_input(std::string const& filename)
+{
+	_log = std::make_unique<ReplayLog>(filename, ReplayLog::Mode::record);
+	_console.attach_log(_log.get(), _clock);
+}
+void CPU::replay_input(std::string const& filename)
+{
+	_log = std::make_unique<ReplayLog>(filename, ReplayLog::Mode::replay);
+	_console.attach_log(_log.get(), _clock);
+}
+bool CPU::replay_unfinished() const
+{
+	return _log != nullptr and _log->replaying() and !_log->finished();
+}
+void CPU::take_pending_interrupt()
+{
+	if (_log != nullptr and _log->replaying())
+	{
+		// only the interrupts in the log arrive
+		int64_t priority = 0;
+		if (_log->next(ReplayLog::Event::interrupt, _clock, priority))
+		{
+			_flags.stored_priority = static_cast<int16_t>(priority);
+		}
+		return;
+	}
+	if (!_interrupt_pending)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(_interrupt_mutex);
+	_interrupt_pending = false;
 
-	// get new priority
-	Tryte new_priority = (Tryte(n) << 6);
-	_flags += new_priority;
+	// replace the stored priority
+	_flags.stored_priority = _pending_priority;
+	if (_log != nullptr)
+	{
+		_log->record(ReplayLog::Event::interrupt, _clock, _pending_priority);
+	}
+}
+
+std::vector<CPU::AotBlockEntry>& CPU::aot_registry()
+{
+	static std::vector<AotBlockEntry> registry;
+	return registry;
+}
+bool CPU::register_aot_blocks(AotBlockEntry const* blocks, size_t count)
+{
+	aot_registry().insert(aot_registry().end(), blocks, blocks + count);
+	return true;
+}
+bool CPU::aot_code_matches(int16_t const* addrs, int16_t const* instrs, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (Tryte::get_int(_memory.load(addrs[i])) != instrs[i])
+		{
+			return false;
+		}
+	}
+	return true;
 }
\ No newline at end of file
@@ -1,159 +1,254 @@
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <ciso646>
+#include <unistd.h>
 #include "Console.h"
 #include "Trint.h"
 #include "Tryte.h"
 #include "Float.h"
 
-Console::Console()
+Console::Console(std::ostream& output, std::istream& input)
 {
 	// on console start, set to raw mode (all Trytes in raw septavingtesmal form)
 	_output_mode = OutputMode::raw;
+	_tryte_texts = nullptr;
+	_input = nullptr;
+	_log = nullptr;
+	_clock = nullptr;
+	_output = &output;
+	_input_stream = &input;
+	// a terminal shows each line as soon as it's finished
+	_interactive = _output == &std::cout and isatty(STDOUT_FILENO);
+	set_buffer_size(default_buffer_size);
 }
-Console& Console::operator<<(Tryte& t)
+Console::~Console()
 {
-	if (_output_mode == OutputMode::raw)
-	{
-		std::cout << Tryte::septavingt_string(t);
-	}
-	else if (_output_mode == OutputMode::ternary)
-	{
-		std::cout << Tryte::ternary_string(t);
-	}
-	else if (_output_mode == OutputMode::number)
-	{
-		std::cout << Tryte::get_int(t);
-	}
-	else if (_output_mode == OutputMode::dense_text)
+	write_buffer();
+	_output->flush();
+}
+Console::TryteTexts const* Console::tryte_texts(OutputMode mode)
+{
+	// fill in a table, given each Tryte's text
+	auto build = [](size_t stride, auto text_of) {
+		TryteTexts texts = { stride, std::vector<uint8_t>(19683), std::vector<char>(19683 * stride) };
+		for (int16_t i = -9841; i <= 9841; i++)
+		{
+			std::string text = text_of(i);
+			texts.lengths[i + 9841] = static_cast<uint8_t>(text.size());
+			text.copy(&texts.text[(i + 9841) * stride], text.size());
+		}
+		return texts;
+	};
+
+	// function statics, so each table is built once, by whichever computer uses it first
+	switch (mode)
 	{
-		int16_t tryte_int = Tryte::get_int(t);
-		std::string out_string = "";
-		uint8_t first_char = (tryte_int + 9841) / 128;
-		uint8_t second_char = (tryte_int + 9841) % 128;
-		// strip away zeroes in Tryte
-		if (first_char == 0)
+		case OutputMode::raw:
 		{
-			out_string += second_char;
-			std::cout << out_string;
+			static TryteTexts const texts = build(3, [](int16_t i) { return Tryte::septavingt_string(Tryte(i)); });
+			return &texts;
 		}
-		else if (second_char == 0)
+		case OutputMode::ternary:
 		{
-			out_string += first_char;
-			std::cout << out_string;
+			static TryteTexts const texts = build(9, [](int16_t i) { return Tryte::ternary_string(Tryte(i)); });
+			return &texts;
 		}
-		else if (first_char == 0 and second_char == 0)
+		case OutputMode::number:
 		{
-			std::cout << out_string;
+			static TryteTexts const texts = build(6, [](int16_t i) { return std::to_string(i); });
+			return &texts;
 		}
-		else
+		case OutputMode::dense_text:
 		{
-			out_string += first_char;
-			out_string += second_char;
-			std::cout << out_string;
+			// two 7-bit chars, dropping either if it's 0 (a Tryte of two zeroes prints one NUL)
+			static TryteTexts const texts = build(2, [](int16_t i) {
+				char first_char = (i + 9841) / 128;
+				char second_char = (i + 9841) % 128;
+				if (first_char == 0)
+				{
+					return std::string(1, second_char);
+				}
+				if (second_char == 0)
+				{
+					return std::string(1, first_char);
+				}
+				return std::string{ first_char, second_char };
+			});
+			return &texts;
 		}
+		case OutputMode::wide_text:
+		{
+			// a single char - the low byte of the Tryte's unsigned value
+			static TryteTexts const texts = build(1, [](int16_t i) { return std::string(1, static_cast<char>(i + 9841)); });
+			return &texts;
+		}
+		default:
+			// graphics: to be implemented later
+			return nullptr;
 	}
-	else if (_output_mode == OutputMode::wide_text)
-	{
-		char16_t out_char = (Tryte::get_int(t) + 9841);
-		std::string out_string;
-		out_string += out_char;
-		std::cout << out_string;	
-	}
-	else if (_output_mode == OutputMode::graphics)
-	{
-		// graphics
-	}
-	return *this;
 }
-Console& Console::operator<<(Trint<3>& trint)
+void Console::write_tryte(TryteTexts const& texts, Tryte const& t)
 {
-	if (_output_mode == OutputMode::raw)
+	size_t i = Tryte::get_int(t) + 9841;
+	write(&texts.text[i * texts.stride], texts.lengths[i]);
+}
+void Console::write(char const* text, size_t length)
+{
+	size_t start = _buffer.size();
+	_buffer.append(text, length);
+	if (_interactive and std::memchr(_buffer.data() + start, '\n', length) != nullptr)
 	{
-		std::cout << Tryte::septavingt_string(trint[0]) << ' ';
-		std::cout << Tryte::septavingt_string(trint[1]) << ' ';
-		std::cout << Tryte::septavingt_string(trint[2]);
+		flush();
 	}
-	else if (_output_mode == OutputMode::ternary)
+	else if (_buffer.size() >= _buffer_size)
 	{
-		std::cout << Tryte::ternary_string(trint[0]) << ' ';
-		std::cout << Tryte::ternary_string(trint[1]) << ' ';
-		std::cout << Tryte::ternary_string(trint[2]);
+		write_buffer();
 	}
-	else if (_output_mode == OutputMode::number)
+}
+void Console::write_buffer()
+{
+	if (!_buffer.empty())
 	{
-		std::cout << Trint<3>::get_int(trint);
+		_output->write(_buffer.data(), _buffer.size());
+		_buffer.clear();
 	}
-	else if (_output_mode == OutputMode::dense_text)
+}
+Console& Console::operator<<(Tryte& t)
+{
+	if (_tryte_texts == nullptr)
 	{
-		// dense text
+		_tryte_texts = tryte_texts(_output_mode);
+		if (_tryte_texts == nullptr)
+		{
+			return *this;
+		}
 	}
-	else if (_output_mode == OutputMode::wide_text)
+	write_tryte(*_tryte_texts, t);
+	return *this;
+}
+Console& Console::operator<<(Trint<3>& trint)
+{
+	if (_output_mode == OutputMode::raw or _output_mode == OutputMode::ternary)
 	{
-		// wide text
+		TryteTexts const& texts = *tryte_texts(_output_mode);
+		write_tryte(texts, trint[0]);
+		write(" ", 1);
+		write_tryte(texts, trint[1]);
+		write(" ", 1);
+		write_tryte(texts, trint[2]);
 	}
-	else if (_output_mode == OutputMode::graphics)
+	else if (_output_mode == OutputMode::number)
 	{
-		// graphics
+		char text[24];
+		char* text_end = std::to_chars(text, text + sizeof(text), Trint<3>::get_int(trint)).ptr;
+		write(text, text_end - text);
 	}
+	// nothing for dense text, wide text or graphics yet
 	return *this;
 }
 Console& Console::operator<<(TFloat& tfloat)
 {
-	if (_output_mode == OutputMode::raw)
+	if (_output_mode == OutputMode::raw or _output_mode == OutputMode::ternary)
 	{
+		TryteTexts const& texts = *tryte_texts(_output_mode);
 		Trint<1> tfloat_exponent = TFloat::get_exponent(tfloat);
 		Trint<2> tfloat_mantissa = TFloat::get_mantissa(tfloat);
-		std::cout << Tryte::septavingt_string(tfloat_exponent[0]) << ' ';
-		std::cout << Tryte::septavingt_string(tfloat_mantissa[0]) << ' ';
-		std::cout << Tryte::septavingt_string(tfloat_mantissa[1]) << ' ';
-	}
-	else if (_output_mode == OutputMode::ternary)
-	{
-		Trint<1> tfloat_exponent = TFloat::get_exponent(tfloat);
-		Trint<2> tfloat_mantissa = TFloat::get_mantissa(tfloat);
-		std::cout << Tryte::ternary_string(tfloat_exponent[0]) << ' ';
-		std::cout << Tryte::ternary_string(tfloat_mantissa[0]) << ' ';
-		std::cout << Tryte::ternary_string(tfloat_mantissa[1]) << ' ';
+		write_tryte(texts, tfloat_exponent[0]);
+		write(" ", 1);
+		write_tryte(texts, tfloat_mantissa[0]);
+		write(" ", 1);
+		write_tryte(texts, tfloat_mantissa[1]);
+		write(" ", 1);
 	}
 	else if (_output_mode == OutputMode::number)
 	{
-		std::cout << TFloat::get_double(tfloat);
-	}
-	else if (_output_mode == OutputMode::dense_text)
-	{
-		// do nothing, can't interpret a float as chars
-	}
-	else if (_output_mode == OutputMode::wide_text)
-	{
-		// do nothing, can't interpret a float as chars
-	}
-	else if (_output_mode == OutputMode::graphics)
-	{
-		// do nothing, can't interpret a float as graphics
+		// as std::ostream formats a double by default
+		char text[32];
+		int length = std::snprintf(text, sizeof(text), "%g", TFloat::get_double(tfloat));
+		write(text, length);
 	}
+	// do nothing for text or graphics - can't interpret a float as chars
 	return *this;
 }
 Console& Console::operator<<(std::string out_string)
 {
-	std::cout << out_string;
+	write(out_string.data(), out_string.size());
 	return *this;
 }
 Console& Console::operator<<(char c)
 {
-	std::cout << c;
+	write(&c, 1);
 	return *this;
 }
-Console& Console::operator>>(char input)
+Console& Console::operator>>(char& input)
 {
-	// when stream fails, just feed in zeroes
-	if (!(std::cin >> input))
+	if (_log != nullptr and _log->replaying())
 	{
-		input = 0;
+		input = static_cast<char>(_log->expect(ReplayLog::Event::input, *_clock));
+		return *this;
+	}
+
+	if (_input != nullptr)
+	{
+		// skip whitespace, as reading the stream does. No input waiting - feed in zeroes
+		do
+		{
+			if (!_input->read(input))
+			{
+				input = 0;
+				break;
+			}
+		} while (std::isspace(static_cast<unsigned char>(input)));
+	}
+	else
+	{
+		// anything printed (a prompt, say) goes out before waiting for input
+		write_buffer();
+		// when stream fails, just feed in zeroes
+		if (!(*_input_stream >> input))
+		{
+			input = 0;
+		}
+	}
+
+	if (_log != nullptr)
+	{
+		_log->record(ReplayLog::Event::input, *_clock, input);
 	}
-		
 	return *this;
 }
+void Console::attach_input(InputDevice* input)
+{
+	_input = input;
+}
+void Console::attach_log(ReplayLog* log, size_t const& clock)
+{
+	_log = log;
+	_clock = &clock;
+}
+void Console::redirect(std::ostream& output, std::istream& input)
+{
+	// output so far belongs to the old stream
+	write_buffer();
+	_output = &output;
+	_input_stream = &input;
+	_interactive = _output == &std::cout and isatty(STDOUT_FILENO);
+}
+void Console::flush()
+{
+	write_buffer();
+	_output->flush();
+}
+void Console::set_buffer_size(size_t bytes)
+{
+	write_buffer();
+	_buffer_size = bytes;
+	_buffer.reserve(bytes);
+}
 int16_t Console::get_output_mode()
 {
 	if (_output_mode == OutputMode::raw)
@@ -187,27 +282,57 @@ int16_t Console::get_output_mode()
 	}
 	
 }
+void Console::set_output_mode(int16_t mode)
+{
+	switch (mode)
+	{
+		case 1:
+			ternary_mode();
+			break;
+		case 2:
+			number_mode();
+			break;
+		case 3:
+			dense_text_mode();
+			break;
+		case 4:
+			wide_text_mode();
+			break;
+		case 5:
+			graphics_mode();
+			break;
+		default:
+			raw_mode();
+			break;
+	}
+}
 void Console::raw_mode()
 {
 	_output_mode = OutputMode::raw;
+	_tryte_texts = nullptr;
 }
 void Console::ternary_mode()
 {
 	_output_mode = OutputMode::ternary;
+	_tryte_texts = nullptr;
 }
 void Console::number_mode()
 {
 	_output_mode = OutputMode::number;
+	_tryte_texts = nullptr;
 }
 void Console::dense_text_mode()
 {
 	_output_mode = OutputMode::dense_text;
+	_tryte_texts = nullptr;
 }
 void Console::wide_text_mode()
 {
 	_output_mode = OutputMode::wide_text;
+	_tryte_texts = nullptr;
 }
 void Console::graphics_mode()
 {
 	_output_mode = OutputMode::graphics;
+	_tryte_texts = nullptr;
 }
\ No newline at end of file
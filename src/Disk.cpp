@@ -0,0 +1,201 @@
+#include "Disk.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::string const Disk::binary_header = std::string("TRIDISK") + '\x01';
+
+Disk::Disk(std::string const& filename)
+{
+	_filename = filename;
+	_binary = Disk::is_binary_file(filename);
+	_fd = -1;
+	_mapping = nullptr;
+	_text_length = 0;
+	_data = nullptr;
+	_dirty_begin = Disk::size;
+	_dirty_end = 0;
+
+	if (_binary)
+	{
+		open_binary();
+	}
+	else
+	{
+		open_text();
+	}
+}
+Disk::~Disk()
+{
+	flush();
+	if (_mapping != nullptr)
+	{
+		munmap(_mapping, binary_header.size() + 2 * Disk::size);
+	}
+	if (_fd >= 0)
+	{
+		close(_fd);
+	}
+}
+void Disk::open_binary()
+{
+	_fd = open(_filename.c_str(), O_RDWR);
+	if (_fd < 0)
+	{
+		throw std::runtime_error("Could not open disk " + _filename + ".\n");
+	}
+
+	// extend short disks to full size - the new Trytes read as zero
+	size_t file_size = binary_header.size() + 2 * Disk::size;
+	struct stat file_stat;
+	if (fstat(_fd, &file_stat) < 0 or (static_cast<size_t>(file_stat.st_size) < file_size and ftruncate(_fd, file_size) < 0))
+	{
+		close(_fd);
+		throw std::runtime_error("Could not resize disk " + _filename + ".\n");
+	}
+
+	void* mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	if (mapping == MAP_FAILED)
+	{
+		close(_fd);
+		throw std::runtime_error("Could not map disk " + _filename + ".\n");
+	}
+	_mapping = static_cast<unsigned char*>(mapping);
+	// the header is 8 bytes, so the Trytes are suitably aligned
+	_data = reinterpret_cast<int16_t*>(_mapping + binary_header.size());
+}
+void Disk::open_text()
+{
+	std::ifstream disk(_filename, std::ios::binary);
+	if (!disk)
+	{
+		throw std::runtime_error("Could not open disk " + _filename + ".\n");
+	}
+
+	// read the whole file in one go, then parse it straight into the buffer
+	disk.seekg(0, std::ios::end);
+	std::string text(static_cast<size_t>(disk.tellg()), '\0');
+	disk.seekg(0, std::ios::beg);
+	disk.read(&text[0], text.size());
+
+	static_assert(sizeof(Tryte) == sizeof(int16_t), "Tryte must be a bare int16_t");
+	_buffer.assign(Disk::size, 0);
+	_text_length = Tryte::parse_text(text.data(), text.size(), reinterpret_cast<Tryte*>(_buffer.data()), Disk::size);
+	_data = _buffer.data();
+}
+
+bool Disk::is_binary() const
+{
+	return _binary;
+}
+std::string const& Disk::filename() const
+{
+	return _filename;
+}
+
+size_t Disk::load(size_t disk_addr, size_t n, Memory<19683>& memory, Tryte const& mem_addr)
+{
+	// text disks end where their file does (or where a SAVE has extended them to)
+	size_t end = _binary ? Disk::size : std::max(_text_length, _dirty_end);
+	if (disk_addr >= end)
+	{
+		return 0;
+	}
+	if (n > end - disk_addr)
+	{
+		n = end - disk_addr;
+	}
+	int16_t const* source = _data + disk_addr;
+	int64_t dest = Tryte::get_int(mem_addr);
+	if (static_cast<size_t>(dest + 9841) + n <= Disk::size)
+	{
+		// no wrap-around - copy straight into memory's backing store (with relaxed stores, as Memory::store does)
+		int16_t* dest_trytes = reinterpret_cast<int16_t*>(memory.data() + static_cast<size_t>(dest + 9841));
+		for (size_t i = 0; i < n; i++)
+		{
+			__atomic_store_n(dest_trytes + i, source[i], __ATOMIC_RELAXED);
+		}
+		return n;
+	}
+	for (size_t i = 0; i < n; i++)
+	{
+		// Tryte(int64_t) wraps the address round memory, as adding to a Tryte would
+		memory.store(Tryte(dest + i), Tryte(source[i]));
+	}
+	return n;
+}
+void Disk::save(Memory<19683>& memory, Tryte const& mem_addr, size_t n, size_t disk_addr)
+{
+	if (disk_addr >= Disk::size)
+	{
+		return;
+	}
+	if (n > Disk::size - disk_addr)
+	{
+		n = Disk::size - disk_addr;
+	}
+	int16_t* dest = _data + disk_addr;
+	int64_t source = Tryte::get_int(mem_addr);
+	for (size_t i = 0; i < n; i++)
+	{
+		dest[i] = Tryte::get_int(memory.load(Tryte(source + i)));
+	}
+	_dirty_begin = std::min(_dirty_begin, disk_addr);
+	_dirty_end = std::max(_dirty_end, disk_addr + n);
+}
+void Disk::flush()
+{
+	if (_dirty_begin >= _dirty_end)
+	{
+		return;
+	}
+
+	if (_binary)
+	{
+		// the mapping is shared, so the file already sees the changes - just make sure they reach the disk
+		long page_size = sysconf(_SC_PAGESIZE);
+		size_t begin = binary_header.size() + 2 * _dirty_begin;
+		size_t end = binary_header.size() + 2 * _dirty_end;
+		begin -= begin % page_size;
+		msync(_mapping + begin, end - begin, MS_SYNC);
+	}
+	else
+	{
+		// rewrite the changed Trytes, along with any gap between the old end of the file and the changes
+		// (which is still zero in the buffer, so is padded with "000 ")
+		size_t begin = std::min(_dirty_begin, _text_length);
+		std::string text(4 * (_dirty_end - begin), '\0');
+		Tryte::septavingt_text(reinterpret_cast<Tryte const*>(_buffer.data() + begin), _dirty_end - begin, &text[0], ' ');
+		std::fstream disk(_filename, std::ios::in | std::ios::out);
+		if (begin == _text_length and begin > 0)
+		{
+			// appending - the file's last Tryte may not have a separator after it
+			disk.seekg(4 * begin - 1);
+			int last = disk.peek();
+			if (last != ' ' and last != '\n' and last != '\r' and last != '\t')
+			{
+				disk.clear();
+				disk.seekp(4 * begin - 1);
+				disk.put(' ');
+			}
+		}
+		disk.seekp(4 * begin);
+		disk.write(text.data(), text.size());
+		_text_length = std::max(_text_length, _dirty_end);
+	}
+
+	_dirty_begin = Disk::size;
+	_dirty_end = 0;
+}
+
+bool Disk::is_binary_file(std::string const& filename)
+{
+	std::ifstream disk(filename, std::ios::binary);
+	std::string header(binary_header.size(), '\0');
+	disk.read(&header[0], header.size());
+	return disk and header == binary_header;
+}
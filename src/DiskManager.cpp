@@ -0,0 +1,51 @@
+#include "DiskManager.h"
+#include <stdexcept>
+
+DiskManager::DiskManager(std::vector<std::string> const& disknames)
+{
+	for (auto const& diskname : disknames)
+	{
+		_disks.push_back(std::make_unique<Disk>(diskname));
+	}
+	_mounted = 0;
+}
+DiskManager::~DiskManager()
+{
+	flush();
+}
+
+size_t DiskManager::size() const
+{
+	return _disks.size();
+}
+void DiskManager::mount(size_t n)
+{
+	if (n >= _disks.size())
+	{
+		throw std::runtime_error("Tried to mount a disk that doesn't exist.\n");
+	}
+	if (n != _mounted)
+	{
+		_disks[_mounted]->flush();
+		_mounted = n;
+	}
+}
+Disk& DiskManager::mounted()
+{
+	if (_disks.empty())
+	{
+		throw std::runtime_error("No disks are connected.\n");
+	}
+	return *_disks[_mounted];
+}
+size_t DiskManager::mounted_number() const
+{
+	return _mounted;
+}
+void DiskManager::flush()
+{
+	for (auto& disk : _disks)
+	{
+		disk->flush();
+	}
+}
@@ -0,0 +1,159 @@
+#include "Display.h"
+#include <algorithm>
+
+Display::Display(Memory<19683>& memory, Console& console, std::mutex& console_mutex, unsigned frame_rate)
+	: _memory(memory), _console(console), _console_mutex(console_mutex)
+{
+	_colour = 0;
+	_stopping = false;
+	clear();
+	_frame_interval = std::chrono::steady_clock::duration::zero();
+	if (frame_rate > 0)
+	{
+		_frame_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::seconds(1)) / frame_rate;
+	}
+	start();
+}
+Display::~Display()
+{
+	stop();
+}
+
+void Display::start()
+{
+	if (_frame_interval == std::chrono::steady_clock::duration::zero() or _thread.joinable())
+	{
+		return;
+	}
+	_stopping = false;
+	_thread = std::thread(&Display::frame_loop, this);
+}
+void Display::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_stop_mutex);
+		_stopping = true;
+	}
+	_stop_signal.notify_all();
+	if (_thread.joinable())
+	{
+		_thread.join();
+	}
+}
+void Display::clear()
+{
+	// the screen is cleared to blank cells before the first frame
+	_shown.assign(rows * columns, 0);
+	_started = false;
+}
+
+void Display::frame_loop()
+{
+	auto next_frame = std::chrono::steady_clock::now() + _frame_interval;
+	std::unique_lock<std::mutex> lock(_stop_mutex);
+	while (!_stop_signal.wait_until(lock, next_frame, [this]() { return _stopping; }))
+	{
+		// a frame that runs late pushes the next one back, rather than causing a burst
+		next_frame = std::max(next_frame + _frame_interval, std::chrono::steady_clock::now());
+		lock.unlock();
+		{
+			std::lock_guard<std::mutex> console_lock(_console_mutex);
+			render();
+		}
+		lock.lock();
+	}
+}
+
+void Display::render()
+{
+	if (_console.get_output_mode() != 5)
+	{
+		return;
+	}
+
+	_frame.clear();
+	if (!_started)
+	{
+		// hide the cursor, and start from a blank screen in the default colours
+		_frame += "\x1b[?25l\x1b[0m\x1b[2J";
+		_started = true;
+	}
+
+	// cores may be writing the framebuffer as it's read - a frame can catch a cell half way through
+	// an update, but the next frame puts it right
+	static_assert(sizeof(Tryte) == sizeof(int16_t), "Tryte must be a bare int16_t");
+	int16_t const* cells = reinterpret_cast<int16_t const*>(_memory.data()) + base + 9841;
+	// the cell the terminal's cursor is at (rows * columns - don't know)
+	size_t cursor = rows * columns;
+	for (size_t i = 0; i < rows * columns; i++)
+	{
+		int16_t cell = __atomic_load_n(cells + i, __ATOMIC_RELAXED);
+		if (cell == _shown[i])
+		{
+			continue;
+		}
+		if (cursor < i and i - cursor <= 4 and cursor / columns == i / columns)
+		{
+			// a short gap is cheaper to draw again than to jump over
+			for (; cursor < i; cursor++)
+			{
+				draw_cell(_shown[cursor]);
+			}
+		}
+		else if (cursor != i)
+		{
+			move_to(i);
+		}
+		draw_cell(cell);
+		_shown[i] = cell;
+		// the cursor is left somewhere terminals disagree on after the last column
+		cursor = (i + 1) % columns == 0 ? rows * columns : i + 1;
+	}
+	if (_frame.empty())
+	{
+		return;
+	}
+
+	// leave the terminal in its default colours, with the cursor below the picture, so any text
+	// printed meanwhile goes there
+	if (_colour != 0)
+	{
+		_frame += "\x1b[0m";
+		_colour = 0;
+	}
+	move_to(rows * columns);
+	_console << _frame;
+	_console.flush();
+}
+void Display::finish()
+{
+	if (_console.get_output_mode() != 5)
+	{
+		return;
+	}
+	render();
+	_console << std::string("\x1b[?25h");
+	_console.flush();
+}
+
+void Display::draw_cell(int16_t cell)
+{
+	// split the cell (rounding down, as the cell may be negative)
+	int glyph = ((cell % 128) + 128) % 128;
+	int colour = (cell - glyph) / 128;
+	int foreground = ((colour % 9) + 9) % 9;
+	int background = (((colour - foreground) / 9 % 9) + 9) % 9;
+	if (foreground + 9 * background != _colour)
+	{
+		_colour = foreground + 9 * background;
+		_frame += "\x1b[" + std::to_string(foreground == 0 ? 39 : 29 + foreground) + ';'
+			+ std::to_string(background == 0 ? 49 : 39 + background) + 'm';
+	}
+	_frame += glyph >= 32 and glyph < 127 ? static_cast<char>(glyph) : ' ';
+}
+void Display::move_to(size_t cell)
+{
+	// terminal rows and columns count from 1
+	_frame += "\x1b[" + std::to_string(cell / columns + 1) + ';' + std::to_string(cell % columns + 1) + 'H';
+}
@@ -5,13 +5,13 @@
 #include "Console.h"
 #include "Memory.h"
 
-FPU::FPU(Memory<19683>& memory, Console& console, Tryte& flags, Tryte& i_ptr, Tryte& s_ptr) : 
-_memory{memory}, _console{console}, _flags{flags}, _i_ptr{i_ptr}, _s_ptr{s_ptr}
+FPU::FPU(Memory<19683>& memory, Console& console, std::mutex& console_mutex, Flags& flags, Tryte& i_ptr, Tryte& s_ptr) : 
+_memory{memory}, _console{console}, _console_mutex{console_mutex}, _flags{flags}, _i_ptr{i_ptr}, _s_ptr{s_ptr}
 {
     // zero all registers
-    for (auto& reg : float_regs)
+    for (auto& reg : _float_regs)
     {
-        *reg = 0.0;
+        reg = 0.0;
     }
 
     // set error to false - if halt_and_catch_fire triggered, FPU will signal an error
@@ -33,32 +33,32 @@ void FPU::handle_instr(Tryte instruction)
         {
             case 0:
                 // f(M-K)(M-m) - FSET Fx, Fy
-                set_float(*float_regs[mid_2], *float_regs[low_2]);
+                set_float(_float_regs[mid_2], _float_regs[low_2]);
                 break;
             
             case 1:
                 // f(J-H)(M-m) - FCMP Fx, Fy
-                compare_floats(*float_regs[mid_2], *float_regs[low_2]);
+                compare_floats(_float_regs[mid_2], _float_regs[low_2]);
                 break;
             
             case 2:
                 // f(G-E)(M-m) - FADD Fx, Fy
-                add_floats(*float_regs[mid_2], *float_regs[low_2]);
+                add_floats(_float_regs[mid_2], _float_regs[low_2]);
                 break;
             
             case 3:
                 // f(D-B)(M-m) - FMUL Fx, Fy
-                mult_floats(*float_regs[mid_2], *float_regs[low_2]);
+                mult_floats(_float_regs[mid_2], _float_regs[low_2]);
                 break;
             
             case 4:
                 // f(A-a)(M-m) - FDIV Fx, Fy
-                div_floats(*float_regs[mid_2], *float_regs[low_2]);
+                div_floats(_float_regs[mid_2], _float_regs[low_2]);
                 break;
             
             case 8:
                 // f(k-m)(M-m) - FSWAP Fx, Fy
-                swap_floats(*float_regs[mid_2], *float_regs[low_2]);
+                swap_floats(_float_regs[mid_2], _float_regs[low_2]);
                 break;
             
             default:
@@ -72,63 +72,63 @@ void FPU::handle_instr(Tryte instruction)
         {
             case 0:
                 // g0X - FCMP X, n
-                compare_float_to_num(*float_regs[low_2]);
+                compare_float_to_num(_float_regs[low_2]);
                 break;
             case 1:
                 // gaX - FSHOW Fx
-                show_float(*float_regs[low_2]);
+                show_float(_float_regs[low_2]);
                 break;
             case -1:
                 // gAX - FTELL Fx
-                tell_float(*float_regs[low_2]);
+                tell_float(_float_regs[low_2]);
                 break;
             case 2:
                 // gbX - FPUSH Fx
-                push_float(*float_regs[low_2]);
+                push_float(_float_regs[low_2]);
                 break;
             case -2:
                 // gBX - FPOP Fx
-                pop_float(*float_regs[low_2]);
+                pop_float(_float_regs[low_2]);
                 break;
             case 3:
                 // gcX - FSET Fx, $Y
-                set_float_to_addr(*float_regs[low_2]);
+                set_float_to_addr(_float_regs[low_2]);
                 break;
             case -3:
                 // gCX - FSET Fx, n
-                set_float_to_num(*float_regs[low_2]);
+                set_float_to_num(_float_regs[low_2]);
                 break;
             case 4:
                 // gdX - FFLIP Fx
-                flip_float(*float_regs[low_2]);
+                flip_float(_float_regs[low_2]);
                 break;
             case -4:
                 // gDX - FABS Fx
-                abs_float(*float_regs[low_2]);
+                abs_float(_float_regs[low_2]);
                 break;
             case 5:
                 // geX - FADD Fx, n
-                add_num_to_float(*float_regs[low_2]);
+                add_num_to_float(_float_regs[low_2]);
                 break;
             case 6:
                 // gfX - FMUL Fx, n
-                mult_float_by_num(*float_regs[low_2]);
+                mult_float_by_num(_float_regs[low_2]);
                 break;
             case 7:
                 // ggX - FDIV Fx, n
-                div_float_by_num(*float_regs[low_2]);
+                div_float_by_num(_float_regs[low_2]);
                 break;
             case 12:
                 // glX - PEEK Fx
-                peek_float(*float_regs[low_2]);
+                peek_float(_float_regs[low_2]);
                 break;
             case 13:
                 // gmY - FREAD $X, Fy
-                read_float(*float_regs[low_2]);
+                read_float(_float_regs[low_2]);
                 break;
             case -13:
                 // gMY - FWRITE Fx, $Y
-                write_float(*float_regs[low_2]);
+                write_float(_float_regs[low_2]);
                 break;
             default:
                 halt_and_catch_fire();
@@ -139,20 +139,24 @@ void FPU::handle_instr(Tryte instruction)
         halt_and_catch_fire();
     }      
 }
+TFloat& FPU::float_reg(size_t n)
+{
+    return _float_regs[n];
+}
 void FPU::dump()
 {
     _console.number_mode();
     _console << "Float registers:\n";
-    _console << "f0 = " << _f0 << " f1 = " << _f1 << " f2 = " << _f2 << '\n';
-    _console << "f3 = " << _f3 << " f4 = " << _f4 << " f5 = " << _f5 << '\n';
-    _console << "f6 = " << _f6 << " f7 = " << _f7 << " f8 = " << _f8 << '\n';
+    _console << "f0 = " << _float_regs[0] << " f1 = " << _float_regs[1] << " f2 = " << _float_regs[2] << '\n';
+    _console << "f3 = " << _float_regs[3] << " f4 = " << _float_regs[4] << " f5 = " << _float_regs[5] << '\n';
+    _console << "f6 = " << _float_regs[6] << " f7 = " << _float_regs[7] << " f8 = " << _float_regs[8] << '\n';
 }
 void FPU::reset()
 {
     // zero all registers
-    for (auto& reg : float_regs)
+    for (auto& reg : _float_regs)
     {
-        *reg = 0.0;
+        reg = 0.0;
     }
 
     error = false;
@@ -163,28 +167,30 @@ input/output
 */
 void FPU::read_float(TFloat& fy)
 {
-    Tryte& add_x = _memory[_i_ptr + 1];
-    Trint<1> exponent = Trint<1>(std::array<Tryte, 1>({_memory[add_x]}));
-    Trint<2> mantissa = Trint<2>(std::array<Tryte, 2>({_memory[add_x + 1], _memory[add_x + 2]}));
+    Tryte add_x = _memory.load(_i_ptr + 1);
+    Trint<1> exponent = Trint<1>(std::array<Tryte, 1>({_memory.load(add_x)}));
+    Trint<2> mantissa = Trint<2>(std::array<Tryte, 2>({_memory.load(add_x + 1), _memory.load(add_x + 2)}));
     fy = TFloat(exponent, mantissa);
     _i_ptr += 2;
 }
 void FPU::write_float(TFloat& fx)
 {
-    Tryte& add_x = _memory[_i_ptr + 1];
-    _memory[add_x] = TFloat::get_exponent(fx)[0];
+    Tryte add_x = _memory.load(_i_ptr + 1);
+    _memory.store(add_x, TFloat::get_exponent(fx)[0]);
     Trint<2> fx_mantissa = TFloat::get_mantissa(fx);
-    _memory[add_x + 1] = fx_mantissa[0];
-    _memory[add_x + 2] = fx_mantissa[1];
+    _memory.store(add_x + 1, fx_mantissa[0]);
+    _memory.store(add_x + 2, fx_mantissa[1]);
     _i_ptr += 2;
 }
 void FPU::show_float(TFloat& fx)
 {
+    std::lock_guard<std::mutex> lock(_console_mutex);
     _console << fx;
     _i_ptr += 1;
 }
 void FPU::tell_float(TFloat& fx)
 {
+    std::lock_guard<std::mutex> lock(_console_mutex);
     char c[2] = {0, 0};
     // first fetch exponent tryte
     _console >> c[0] >> c[1];
@@ -205,7 +211,7 @@ stack management
 */
 void FPU::peek_float(TFloat& fx)
 {
-    std::array<Tryte, 3> stack_trytes = { _memory[_s_ptr - 1], _memory[_s_ptr - 2], _memory[_s_ptr - 3] };
+    std::array<Tryte, 3> stack_trytes = { _memory.load(_s_ptr - 1), _memory.load(_s_ptr - 2), _memory.load(_s_ptr - 3) };
 	fx = TFloat(stack_trytes[0], stack_trytes[1], stack_trytes[2]);
 	_i_ptr += 1;
 }
@@ -213,15 +219,15 @@ void FPU::push_float(TFloat& fx)
 {
     Trint<1> fx_exponent = TFloat::get_exponent(fx);
     Trint<2> fx_mantissa = TFloat::get_mantissa(fx);
-    _memory[_s_ptr] = fx_exponent[0];
-    _memory[_s_ptr + 1] = fx_mantissa[0];
-    _memory[_s_ptr + 2] = fx_mantissa[1];
+    _memory.store(_s_ptr, fx_exponent[0]);
+    _memory.store(_s_ptr + 1, fx_mantissa[0]);
+    _memory.store(_s_ptr + 2, fx_mantissa[1]);
     _s_ptr += 3;
     _i_ptr += 1;
 }
 void FPU::pop_float(TFloat& fx)
 {
-    std::array<Tryte, 3> stack_trytes = { _memory[_s_ptr - 1], _memory[_s_ptr - 2], _memory[_s_ptr - 3] };
+    std::array<Tryte, 3> stack_trytes = { _memory.load(_s_ptr - 1), _memory.load(_s_ptr - 2), _memory.load(_s_ptr - 3) };
 	fx = TFloat(stack_trytes[0], stack_trytes[1], stack_trytes[2]);
     _s_ptr -= 3;
 	_i_ptr += 1;
@@ -237,14 +243,14 @@ void FPU::set_float(TFloat& fx, TFloat& fy)
 }
 void FPU::set_float_to_addr(TFloat& fx)
 {
-    Tryte& add_x = _memory[_i_ptr + 1];
-    TFloat new_float(_memory[add_x], _memory[add_x + 1], _memory[add_x + 2]);
+    Tryte add_x = _memory.load(_i_ptr + 1);
+    TFloat new_float(_memory.load(add_x), _memory.load(add_x + 1), _memory.load(add_x + 2));
     fx = new_float;
     _i_ptr += 2;
 }
 void FPU::set_float_to_num(TFloat& fx)
 {
-    TFloat new_float(_memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3]);
+    TFloat new_float(_memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3));
     fx = new_float;
     _i_ptr += 4;
 }
@@ -266,7 +272,7 @@ void FPU::add_floats(TFloat& fx, TFloat& fy)
 }
 void FPU::add_num_to_float(TFloat& fx)
 {
-    TFloat num(_memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3]);
+    TFloat num(_memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3));
     fx += num;
     _i_ptr += 4;
 }
@@ -277,7 +283,7 @@ void FPU::mult_floats(TFloat& fx, TFloat& fy)
 }
 void FPU::mult_float_by_num(TFloat& fx)
 {
-    TFloat num(_memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3]);
+    TFloat num(_memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3));
     fx *= num;
     _i_ptr += 4;
 }
@@ -288,7 +294,7 @@ void FPU::div_floats(TFloat& fx, TFloat& fy)
 }
 void FPU::div_float_by_num(TFloat& fx)
 {
-    TFloat num(_memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3]);
+    TFloat num(_memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3));
     fx /= num;
     _i_ptr += 4;
 }
@@ -296,32 +302,32 @@ void FPU::compare_floats(TFloat& fx, TFloat& fy)
 {
     if (fx < fy)
 	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) - 1;
+		_flags.compare = -1;
 	}
 	else if (fx > fy)
 	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) + 1;
+		_flags.compare = 1;
 	}
 	else
 	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0"));
+		_flags.compare = 0;
 	}
 	_i_ptr += 1;
 }
 void FPU::compare_float_to_num(TFloat& fx)
 {
-    TFloat num(_memory[_i_ptr + 1], _memory[_i_ptr + 2], _memory[_i_ptr + 3]);
+    TFloat num(_memory.load(_i_ptr + 1), _memory.load(_i_ptr + 2), _memory.load(_i_ptr + 3));
     if (fx < num)
 	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) - 1;
+		_flags.compare = -1;
 	}
 	else if (fx > num)
 	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0")) + 1;
+		_flags.compare = 1;
 	}
 	else
 	{
-		_flags = Tryte::tritwise_mult(_flags, Tryte("++++++++0"));
+		_flags.compare = 0;
 	}
 	_i_ptr += 4;
 }
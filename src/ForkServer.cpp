@@ -0,0 +1,177 @@
+#include "ForkServer.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+ForkServer::ForkServer(CPU& cpu, std::string const& manifest_filename) : _cpu(cpu)
+{
+	std::ifstream manifest(manifest_filename);
+	if (!manifest)
+	{
+		throw std::runtime_error("Could not open fork server manifest " + manifest_filename + ".\n");
+	}
+
+	std::string text;
+	size_t line = 0;
+	while (std::getline(manifest, text))
+	{
+		line++;
+		std::istringstream tokens(text);
+		std::string token;
+		if (!(tokens >> token) or token[0] == '#')
+		{
+			continue;
+		}
+
+		Clone clone = { "", "clone" + std::to_string(_clones.size() + 1) + ".out" };
+		do
+		{
+			if (token != "<" and token != ">")
+			{
+				throw std::runtime_error(manifest_filename + ", line " + std::to_string(line)
+					+ ": expected '<' or '>', got '" + token + "'.\n");
+			}
+			std::string& filename = token == "<" ? clone.input_filename : clone.output_filename;
+			if (!(tokens >> filename))
+			{
+				throw std::runtime_error(manifest_filename + ", line " + std::to_string(line)
+					+ ": '" + token + "' needs a file name.\n");
+			}
+		} while (tokens >> token);
+		_clones.push_back(clone);
+	}
+	_results.assign(_clones.size(), { false, 0 });
+}
+
+void ForkServer::run_to_marker()
+{
+	_cpu.run();
+}
+bool ForkServer::run_to_marker(Tryte const& addr)
+{
+	_cpu.run_until(addr);
+	return _cpu.is_on();
+}
+
+size_t ForkServer::run(size_t max_running)
+{
+	if (max_running == 0)
+	{
+		max_running = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// fork() copies only this thread - a clone forked while the display's frame thread held the
+	// device lock would never get it. Each clone starts its own.
+	_cpu.pause_display();
+	// anything buffered now would be written once by every clone
+	_cpu.flush_console();
+	std::cout.flush();
+	std::cerr.flush();
+
+	std::map<pid_t, size_t> running;
+	std::vector<std::chrono::steady_clock::time_point> starts(_clones.size());
+	size_t next = 0;
+	while (next < _clones.size() or !running.empty())
+	{
+		if (next < _clones.size() and running.size() < max_running)
+		{
+			starts[next] = std::chrono::steady_clock::now();
+			pid_t pid = fork();
+			if (pid < 0)
+			{
+				throw std::runtime_error("Could not fork a clone.\n");
+			}
+			if (pid == 0)
+			{
+				run_clone(_cpu, _clones[next]);
+			}
+			running[pid] = next;
+			next++;
+			continue;
+		}
+
+		// wait for a clone to finish
+		int status = 0;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0)
+		{
+			throw std::runtime_error("Lost track of the clones.\n");
+		}
+		auto clone = running.find(pid);
+		if (clone == running.end())
+		{
+			continue;
+		}
+		Result& result = _results[clone->second];
+		result.ok = WIFEXITED(status) and WEXITSTATUS(status) == 0;
+		result.us = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - starts[clone->second]).count();
+		running.erase(clone);
+	}
+
+	size_t failed = 0;
+	for (Result const& result : _results)
+	{
+		failed += result.ok ? 0 : 1;
+	}
+	return failed;
+}
+
+void ForkServer::run_clone(CPU& cpu, Clone const& clone)
+{
+	try
+	{
+		// no input file - reads fail, and the console feeds in zeroes
+		std::ifstream input_file;
+		std::istringstream no_input;
+		std::istream* input = &no_input;
+		if (!clone.input_filename.empty())
+		{
+			input_file.open(clone.input_filename);
+			if (!input_file)
+			{
+				throw std::runtime_error("Could not open input " + clone.input_filename + ".\n");
+			}
+			input = &input_file;
+		}
+		std::ofstream output(clone.output_filename);
+		if (!output)
+		{
+			throw std::runtime_error("Could not write " + clone.output_filename + ".\n");
+		}
+
+		cpu.redirect_console(output, *input);
+		cpu.resume_display();
+		cpu.resume();
+		cpu.run();
+		output.flush();
+		// skip the destructors - they belong to the server
+		_exit(output ? 0 : 1);
+	}
+	catch (std::exception const& e)
+	{
+		std::cerr << clone.output_filename << ": " << e.what();
+		std::cerr.flush();
+		_exit(1);
+	}
+}
+
+size_t ForkServer::size() const
+{
+	return _clones.size();
+}
+ForkServer::Clone const& ForkServer::clone(size_t n) const
+{
+	return _clones[n];
+}
+ForkServer::Result const& ForkServer::result(size_t n) const
+{
+	return _results[n];
+}
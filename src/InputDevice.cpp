@@ -0,0 +1,91 @@
+#include "InputDevice.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <poll.h>
+#include <unistd.h>
+
+InputDevice::InputDevice(int fd, std::function<void()> on_input)
+{
+	_fd = fd;
+	_on_input = on_input;
+	_head = 0;
+	_tail = 0;
+	_closed = false;
+	if (pipe(_stop_pipe) < 0)
+	{
+		throw std::runtime_error("Could not start input device.\n");
+	}
+	_thread = std::thread(&InputDevice::read_loop, this);
+}
+InputDevice::~InputDevice()
+{
+	// wake the input thread up, and wait for it to finish
+	char stop = 0;
+	if (write(_stop_pipe[1], &stop, 1) < 0)
+	{
+		// the thread will still stop at the end of the input
+	}
+	_thread.join();
+	close(_stop_pipe[0]);
+	close(_stop_pipe[1]);
+}
+
+void InputDevice::read_loop()
+{
+	std::array<char, 256> chunk;
+	while (true)
+	{
+		// wait for input, or for the device to be destroyed
+		pollfd fds[2] = { { _fd, POLLIN, 0 }, { _stop_pipe[0], POLLIN, 0 } };
+		if (poll(fds, 2, -1) < 0 or fds[1].revents != 0)
+		{
+			break;
+		}
+
+		// only read as much as will fit in the buffer
+		size_t space = buffer_size - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+		if (space == 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		ssize_t count = ::read(_fd, chunk.data(), std::min(space, chunk.size()));
+		if (count <= 0)
+		{
+			// end of input is an event too - let the CPU know, so a program waiting on input can finish
+			_closed = true;
+			_on_input();
+			return;
+		}
+
+		size_t head = _head.load(std::memory_order_relaxed);
+		for (ssize_t i = 0; i < count; i++)
+		{
+			_buffer[(head + i) % buffer_size] = chunk[i];
+		}
+		_head.store(head + count, std::memory_order_release);
+		_on_input();
+	}
+	_closed = true;
+}
+
+bool InputDevice::read(char& c)
+{
+	size_t tail = _tail.load(std::memory_order_relaxed);
+	if (tail == _head.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	c = _buffer[tail % buffer_size];
+	_tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+size_t InputDevice::available() const
+{
+	return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+}
+bool InputDevice::closed() const
+{
+	return _closed and available() == 0;
+}
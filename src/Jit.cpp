@@ -0,0 +1,316 @@
+#include "Jit.h"
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+Jit::Jit(size_t arena_size)
+{
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	_arena_size = (arena_size + page_size - 1) / page_size * page_size;
+	_used = 0;
+	void* arena = mmap(nullptr, _arena_size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (arena == MAP_FAILED)
+	{
+		throw std::runtime_error("Could not allocate memory for the JIT.\n");
+	}
+	_arena = static_cast<unsigned char*>(arena);
+}
+Jit::~Jit()
+{
+	munmap(_arena, _arena_size);
+}
+
+bool Jit::supported()
+{
+#if defined(__x86_64__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+encoding
+*/
+void Jit::emit(std::initializer_list<unsigned char> bytes)
+{
+	_code.insert(_code.end(), bytes);
+}
+void Jit::emit32(int32_t value)
+{
+	unsigned char bytes[4];
+	std::memcpy(bytes, &value, 4);
+	_code.insert(_code.end(), bytes, bytes + 4);
+}
+void Jit::emit64(int64_t value)
+{
+	unsigned char bytes[8];
+	std::memcpy(bytes, &value, 8);
+	_code.insert(_code.end(), bytes, bytes + 8);
+}
+void Jit::emit_rex(bool wide, Reg reg, Reg index, Reg base, bool force)
+{
+	auto high = [](Reg r) { return r != Reg::none and static_cast<unsigned>(r) >= 8 ? 1 : 0; };
+	unsigned char rex = 0x40 | (wide ? 8 : 0) | high(reg) << 2 | high(index) << 1 | high(base);
+	if (rex != 0x40 or force)
+	{
+		emit({ rex });
+	}
+}
+void Jit::emit_modrm(Reg reg, Reg rm)
+{
+	emit({ static_cast<unsigned char>(0xC0 | (static_cast<unsigned>(reg) & 7) << 3 | (static_cast<unsigned>(rm) & 7)) });
+}
+void Jit::emit_modrm(Reg reg, Mem const& mem)
+{
+	// always a 32 bit displacement (mod 10), so rbp and r13 need no special case
+	unsigned reg_bits = (static_cast<unsigned>(reg) & 7) << 3;
+	unsigned base_bits = static_cast<unsigned>(mem.base) & 7;
+	if (mem.index == Reg::none and base_bits != 4)
+	{
+		emit({ static_cast<unsigned char>(0x80 | reg_bits | base_bits) });
+	}
+	else
+	{
+		// SIB byte - rsp and r12 can only be a base through one, and index 100 means no index
+		unsigned scale_bits = mem.scale == 8 ? 3 : mem.scale == 4 ? 2 : mem.scale == 2 ? 1 : 0;
+		unsigned index_bits = mem.index == Reg::none ? 4 : static_cast<unsigned>(mem.index) & 7;
+		emit({ static_cast<unsigned char>(0x80 | reg_bits | 4),
+			static_cast<unsigned char>(scale_bits << 6 | index_bits << 3 | base_bits) });
+	}
+	emit32(mem.disp);
+}
+void Jit::emit_op(std::initializer_list<unsigned char> opcode, Reg reg, Reg rm)
+{
+	emit_rex(true, reg, Reg::none, rm);
+	emit(opcode);
+	emit_modrm(reg, rm);
+}
+void Jit::emit_op(std::initializer_list<unsigned char> opcode, Reg reg, Mem const& mem)
+{
+	emit_rex(true, reg, mem.index, mem.base);
+	emit(opcode);
+	emit_modrm(reg, mem);
+}
+void Jit::emit_rel32(size_t label)
+{
+	_fixups.push_back({ _code.size(), label });
+	emit32(0);
+}
+
+/*
+building a block
+*/
+void Jit::begin()
+{
+	_code.clear();
+	_labels.clear();
+	_fixups.clear();
+}
+Jit::Label Jit::new_label()
+{
+	_labels.push_back(SIZE_MAX);
+	return { _labels.size() - 1 };
+}
+void Jit::bind(Label label)
+{
+	_labels[label.id] = _code.size();
+}
+
+// the opcode extensions below are passed as the register in the ModRM reg field
+void Jit::mov(Reg dst, Reg src)
+{
+	emit_op({ 0x89 }, src, dst);
+}
+void Jit::mov(Reg dst, int64_t imm)
+{
+	if (imm >= INT32_MIN and imm <= INT32_MAX)
+	{
+		// mov r/m64, imm32 (sign extended)
+		emit_op({ 0xC7 }, Reg::rax, dst);
+		emit32(static_cast<int32_t>(imm));
+		return;
+	}
+	// mov r64, imm64
+	emit_rex(true, Reg::none, Reg::none, dst);
+	emit({ static_cast<unsigned char>(0xB8 | (static_cast<unsigned>(dst) & 7)) });
+	emit64(imm);
+}
+void Jit::load16(Reg dst, Mem const& src)
+{
+	// movsx r64, r/m16
+	emit_op({ 0x0F, 0xBF }, dst, src);
+}
+void Jit::store16(Mem const& dst, Reg src)
+{
+	emit({ 0x66 });
+	emit_rex(false, src, dst.index, dst.base);
+	emit({ 0x89 });
+	emit_modrm(src, dst);
+}
+void Jit::store16(Mem const& dst, int16_t imm)
+{
+	emit({ 0x66 });
+	emit_rex(false, Reg::none, dst.index, dst.base);
+	emit({ 0xC7 });
+	emit_modrm(Reg::rax, dst);
+	unsigned char bytes[2];
+	std::memcpy(bytes, &imm, 2);
+	_code.insert(_code.end(), bytes, bytes + 2);
+}
+void Jit::lea(Reg dst, Mem const& src)
+{
+	emit_op({ 0x8D }, dst, src);
+}
+void Jit::add(Reg dst, Reg src)
+{
+	emit_op({ 0x01 }, src, dst);
+}
+void Jit::add(Reg dst, int32_t imm)
+{
+	emit_op({ 0x81 }, Reg::rax, dst);
+	emit32(imm);
+}
+void Jit::add64(Mem const& dst, int32_t imm)
+{
+	emit_op({ 0x81 }, Reg::rax, dst);
+	emit32(imm);
+}
+void Jit::sub(Reg dst, Reg src)
+{
+	emit_op({ 0x29 }, src, dst);
+}
+void Jit::sub(Reg dst, int32_t imm)
+{
+	emit_op({ 0x81 }, Reg::rbp, dst);
+	emit32(imm);
+}
+void Jit::neg(Reg dst)
+{
+	emit_op({ 0xF7 }, Reg::rbx, dst);
+}
+void Jit::imul(Reg dst, Reg src, int32_t imm)
+{
+	emit_op({ 0x69 }, dst, src);
+	emit32(imm);
+}
+void Jit::mul(Reg src)
+{
+	emit_op({ 0xF7 }, Reg::rsp, src);
+}
+void Jit::cmp(Reg a, Reg b)
+{
+	emit_op({ 0x39 }, b, a);
+}
+void Jit::cmp(Reg a, int32_t imm)
+{
+	emit_op({ 0x81 }, Reg::rdi, a);
+	emit32(imm);
+}
+void Jit::cmp8(Mem const& a, int8_t imm)
+{
+	emit_rex(false, Reg::none, a.index, a.base);
+	emit({ 0x80 });
+	emit_modrm(Reg::rdi, a);
+	emit({ static_cast<unsigned char>(imm) });
+}
+void Jit::cmp16(Mem const& a, int16_t imm)
+{
+	emit({ 0x66 });
+	emit_rex(false, Reg::none, a.index, a.base);
+	emit({ 0x81 });
+	emit_modrm(Reg::rdi, a);
+	unsigned char bytes[2];
+	std::memcpy(bytes, &imm, 2);
+	_code.insert(_code.end(), bytes, bytes + 2);
+}
+void Jit::test(Reg a, Reg b)
+{
+	emit_op({ 0x85 }, b, a);
+}
+void Jit::set(Condition condition, Reg dst)
+{
+	// without a REX prefix, registers 4 to 7 would be ah, ch, dh and bh
+	unsigned dst_number = static_cast<unsigned>(dst);
+	emit_rex(false, Reg::none, Reg::none, dst, dst_number >= 4 and dst_number < 8);
+	emit({ 0x0F, static_cast<unsigned char>(0x90 | static_cast<unsigned>(condition)) });
+	emit_modrm(Reg::rax, dst);
+}
+void Jit::cmov(Condition condition, Reg dst, Reg src)
+{
+	emit_op({ 0x0F, static_cast<unsigned char>(0x40 | static_cast<unsigned>(condition)) }, dst, src);
+}
+void Jit::jump(Label label)
+{
+	emit({ 0xE9 });
+	emit_rel32(label.id);
+}
+void Jit::jump_if(Condition condition, Label label)
+{
+	emit({ 0x0F, static_cast<unsigned char>(0x80 | static_cast<unsigned>(condition)) });
+	emit_rel32(label.id);
+}
+void Jit::call(Reg target)
+{
+	emit_rex(false, Reg::none, Reg::none, target);
+	emit({ 0xFF });
+	emit_modrm(Reg::rdx, target);
+}
+void Jit::push(Reg reg)
+{
+	emit_rex(false, Reg::none, Reg::none, reg);
+	emit({ static_cast<unsigned char>(0x50 | (static_cast<unsigned>(reg) & 7)) });
+}
+void Jit::pop(Reg reg)
+{
+	emit_rex(false, Reg::none, Reg::none, reg);
+	emit({ static_cast<unsigned char>(0x58 | (static_cast<unsigned>(reg) & 7)) });
+}
+void Jit::ret()
+{
+	emit({ 0xC3 });
+}
+
+Jit::Code Jit::install()
+{
+	// patching the jumps gives the same bytes every time, so a block can be installed again
+	for (Fixup const& fixup : _fixups)
+	{
+		int32_t offset = static_cast<int32_t>(_labels[fixup.label] - (fixup.pos + 4));
+		std::memcpy(&_code[fixup.pos], &offset, 4);
+	}
+
+	if (_used + _code.size() > _arena_size)
+	{
+		return nullptr;
+	}
+
+	// W^X - the arena is only writable while the new code is copied in
+	unsigned char* start = _arena + _used;
+	if (mprotect(_arena, _arena_size, PROT_READ | PROT_WRITE) < 0)
+	{
+		throw std::runtime_error("Could not make the JIT's code writable.\n");
+	}
+	std::memcpy(start, _code.data(), _code.size());
+	if (mprotect(_arena, _arena_size, PROT_READ | PROT_EXEC) < 0)
+	{
+		throw std::runtime_error("Could not make the JIT's code executable.\n");
+	}
+	__builtin___clear_cache(reinterpret_cast<char*>(start), reinterpret_cast<char*>(start + _code.size()));
+
+	// keep blocks 16 byte aligned
+	_used += (_code.size() + 15) / 16 * 16;
+	return reinterpret_cast<Code>(start);
+}
+
+void Jit::reset()
+{
+	_used = 0;
+}
+
+Jit::Condition Jit::inverse(Condition condition)
+{
+	// condition codes come in pairs, differing in the lowest bit
+	return static_cast<Condition>(static_cast<unsigned>(condition) ^ 1);
+}
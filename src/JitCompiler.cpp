@@ -0,0 +1,641 @@
+#include "JitCompiler.h"
+
+namespace
+{
+	typedef Jit::Reg Reg;
+	typedef Jit::Condition Condition;
+
+	// the largest Trint<3>, (3^27 - 1) / 2, and the number of Trint<3> values, 3^27
+	int64_t const trint_max = 3812798742493;
+	int64_t const trint_modulus = 7625597484987;
+	// ceil(2^64 / 19683) - the high half of u * this is u / 19683, for any u below 2^64 / 19683
+	int64_t const divide_by_19683 = 937191692003737;
+
+	// the host registers the compiled code keeps fixed
+	Reg const cpu_reg = Reg::rbp;
+	Reg const memory_reg = Reg::rbx;
+	Reg const compare_reg = Reg::r10;
+}
+
+JitCompiler::JitCompiler(CPU& cpu, Jit& jit, std::vector<CPU::BlockOp> const& block)
+	: _cpu(cpu), _jit(jit), _block(block)
+{
+	_slots.fill({ -1, false });
+	_next_victim = 0;
+	_compare_in_reg = false;
+	_ticks = 0;
+}
+
+/*
+operands
+*/
+Jit::Mem JitCompiler::field(void const* member) const
+{
+	return { cpu_reg, static_cast<int32_t>(static_cast<char const*>(member) - reinterpret_cast<char const*>(&_cpu)) };
+}
+Jit::Mem JitCompiler::trint_digit(int16_t n, size_t k) const
+{
+	return field(&_cpu._regs[n][k]);
+}
+Jit::Mem JitCompiler::memory_at(int64_t addr) const
+{
+	// Tryte(int64_t) wraps the address round memory, as the CPU does
+	return { memory_reg, 2 * Tryte::get_int(Tryte(addr)) };
+}
+Jit::Mem JitCompiler::memory_at(Reg addr) const
+{
+	return { memory_reg, 0, addr, 2 };
+}
+int16_t JitCompiler::trint_number(Trint<3> const* reg) const
+{
+	return static_cast<int16_t>(reg - _cpu._regs.data());
+}
+int16_t JitCompiler::trint_number(Tryte const* reg) const
+{
+	return static_cast<int16_t>((reinterpret_cast<char const*>(reg) - reinterpret_cast<char const*>(_cpu._regs.data())) / sizeof(Trint<3>));
+}
+
+/*
+Trint registers held in host registers
+*/
+Reg JitCompiler::slot_reg(size_t slot)
+{
+	return static_cast<Reg>(static_cast<unsigned>(Reg::r12) + slot);
+}
+size_t JitCompiler::slot_of(int16_t n) const
+{
+	for (size_t slot = 0; slot < _slots.size(); slot++)
+	{
+		if (_slots[slot].trint == n)
+		{
+			return slot;
+		}
+	}
+	return _slots.size();
+}
+Reg JitCompiler::trint(int16_t n, bool load, int16_t keep)
+{
+	size_t slot = slot_of(n);
+	if (slot < _slots.size())
+	{
+		return slot_reg(slot);
+	}
+
+	slot = slot_of(-1);
+	if (slot == _slots.size())
+	{
+		// all in use - push one out, round robin
+		slot = _slots[_next_victim].trint == keep ? (_next_victim + 1) % _slots.size() : _next_victim;
+		_next_victim = (slot + 1) % _slots.size();
+		write_back(slot);
+	}
+	_slots[slot] = { n, false };
+	if (load)
+	{
+		load_trint(slot_reg(slot), trint_digit(n, 0), trint_digit(n, 1), trint_digit(n, 2));
+	}
+	return slot_reg(slot);
+}
+void JitCompiler::changed(int16_t n)
+{
+	_slots[slot_of(n)].dirty = true;
+}
+void JitCompiler::write_back(size_t slot)
+{
+	if (_slots[slot].dirty)
+	{
+		int16_t n = _slots[slot].trint;
+		store_trint(slot_reg(slot), trint_digit(n, 0), trint_digit(n, 1), trint_digit(n, 2));
+		_slots[slot].dirty = false;
+	}
+}
+void JitCompiler::release(Tryte const* reg)
+{
+	if (reg == nullptr)
+	{
+		return;
+	}
+	size_t slot = slot_of(trint_number(reg));
+	if (slot < _slots.size())
+	{
+		write_back(slot);
+		_slots[slot].trint = -1;
+	}
+}
+void JitCompiler::sync()
+{
+	for (size_t slot = 0; slot < _slots.size(); slot++)
+	{
+		write_back(slot);
+		_slots[slot].trint = -1;
+	}
+	if (_compare_in_reg)
+	{
+		_jit.store16(field(&_cpu._flags.compare), compare_reg);
+		_compare_in_reg = false;
+	}
+	if (_ticks > 0)
+	{
+		_jit.add64(field(&_cpu._clock), _ticks);
+		_ticks = 0;
+	}
+}
+
+/*
+arithmetic
+*/
+void JitCompiler::load_trint(Reg dst, Jit::Mem const& high, Jit::Mem const& mid, Jit::Mem const& low)
+{
+	// ((high * 19683) + mid) * 19683 + low
+	_jit.load16(dst, high);
+	_jit.imul(dst, dst, 19683);
+	_jit.load16(Reg::rcx, mid);
+	_jit.add(dst, Reg::rcx);
+	_jit.imul(dst, dst, 19683);
+	_jit.load16(Reg::rcx, low);
+	_jit.add(dst, Reg::rcx);
+}
+void JitCompiler::load_trint_at(Reg dst, Reg addr)
+{
+	_jit.load16(dst, memory_at(addr));
+	_jit.imul(dst, dst, 19683);
+	next_address(addr);
+	_jit.load16(Reg::rcx, memory_at(addr));
+	_jit.add(dst, Reg::rcx);
+	_jit.imul(dst, dst, 19683);
+	next_address(addr);
+	_jit.load16(Reg::rcx, memory_at(addr));
+	_jit.add(dst, Reg::rcx);
+}
+void JitCompiler::store_trint(Reg src, Jit::Mem const& high, Jit::Mem const& mid, Jit::Mem const& low)
+{
+	// src + trint_max is 0 to 3^27 - 1, and its base 19683 digits are the Trytes, each 9841 too big
+	_jit.mov(Reg::rcx, trint_max);
+	_jit.add(Reg::rcx, src);
+	std::array<Jit::Mem const*, 2> digits = { &low, &mid };
+	for (Jit::Mem const* digit : digits)
+	{
+		// rdx = rcx / 19683, rcx = rcx % 19683
+		_jit.mov(Reg::rax, divide_by_19683);
+		_jit.mul(Reg::rcx);
+		_jit.imul(Reg::rax, Reg::rdx, 19683);
+		_jit.sub(Reg::rcx, Reg::rax);
+		_jit.sub(Reg::rcx, 9841);
+		_jit.store16(*digit, Reg::rcx);
+		_jit.mov(Reg::rcx, Reg::rdx);
+	}
+	_jit.sub(Reg::rcx, 9841);
+	_jit.store16(high, Reg::rcx);
+}
+void JitCompiler::wrap_trint(Reg value)
+{
+	// value is at most one modulus out either way
+	_jit.mov(Reg::rcx, trint_modulus);
+	_jit.mov(Reg::rdx, trint_max);
+	_jit.mov(Reg::rax, value);
+	_jit.sub(Reg::rax, Reg::rcx);
+	_jit.cmp(value, Reg::rdx);
+	_jit.cmov(Condition::g, value, Reg::rax);
+	_jit.mov(Reg::rax, value);
+	_jit.add(Reg::rax, Reg::rcx);
+	_jit.neg(Reg::rdx);
+	_jit.cmp(value, Reg::rdx);
+	_jit.cmov(Condition::l, value, Reg::rax);
+}
+void JitCompiler::wrap_tryte(Reg value)
+{
+	_jit.lea(Reg::rcx, { value, -19683 });
+	_jit.cmp(value, 9841);
+	_jit.cmov(Condition::g, value, Reg::rcx);
+	_jit.lea(Reg::rcx, { value, 19683 });
+	_jit.cmp(value, -9841);
+	_jit.cmov(Condition::l, value, Reg::rcx);
+}
+void JitCompiler::next_address(Reg addr)
+{
+	_jit.lea(Reg::rax, { addr, 1 - 19683 });
+	_jit.add(addr, 1);
+	_jit.cmp(addr, 9841);
+	_jit.cmov(Condition::g, addr, Reg::rax);
+}
+void JitCompiler::compare(Reg a, Reg b)
+{
+	// compare flag = (a > b) - (a < b)
+	_jit.mov(compare_reg, 0);
+	_jit.mov(Reg::r11, 0);
+	_jit.cmp(a, b);
+	_jit.set(Condition::g, compare_reg);
+	_jit.set(Condition::l, Reg::r11);
+	_jit.sub(compare_reg, Reg::r11);
+	_compare_in_reg = true;
+}
+
+/*
+leaving the block
+*/
+void JitCompiler::exit(Reg const* i_ptr, Tryte const* i_ptr_value, Tryte const& instr)
+{
+	// only code - what is held in host registers is unchanged, for the code after a branch out
+	for (size_t slot = 0; slot < _slots.size(); slot++)
+	{
+		if (_slots[slot].dirty)
+		{
+			int16_t n = _slots[slot].trint;
+			store_trint(slot_reg(slot), trint_digit(n, 0), trint_digit(n, 1), trint_digit(n, 2));
+		}
+	}
+	if (_compare_in_reg)
+	{
+		_jit.store16(field(&_cpu._flags.compare), compare_reg);
+	}
+	if (_ticks > 0)
+	{
+		_jit.add64(field(&_cpu._clock), _ticks);
+	}
+	if (i_ptr != nullptr)
+	{
+		_jit.store16(field(&_cpu._i_ptr), *i_ptr);
+	}
+	else
+	{
+		_jit.store16(field(&_cpu._i_ptr), Tryte::get_int(*i_ptr_value));
+	}
+	_jit.store16(field(&_cpu._instr), Tryte::get_int(instr));
+	_jit.jump(_epilogue);
+}
+
+/*
+instructions
+*/
+bool JitCompiler::compile_inline(CPU::BlockOp const& op)
+{
+	if (op.decoded->handler == &CPU::handle<&CPU::noop>)
+	{
+		return true;
+	}
+	return compile_trint_op(op) or compile_tryte_op(op);
+}
+bool JitCompiler::compile_trint_op(CPU::BlockOp const& op)
+{
+	CPU::DecodedInstr const& decoded = *op.decoded;
+	auto handler = decoded.handler;
+	if (decoded.trint_x == nullptr)
+	{
+		return false;
+	}
+	int16_t x = trint_number(decoded.trint_x);
+	int16_t y = decoded.trint_y == nullptr ? -1 : trint_number(decoded.trint_y);
+	int64_t addr = Tryte::get_int(op.addr);
+
+	if (handler == &CPU::handle_trint_pair<&CPU::set_trint>)
+	{
+		Reg value = trint(y, true);
+		_jit.mov(trint(x, false, y), value);
+		changed(x);
+	}
+	else if (handler == &CPU::handle_trint<&CPU::set_trint_to_num>)
+	{
+		load_trint(trint(x, false), memory_at(addr + 1), memory_at(addr + 2), memory_at(addr + 3));
+		changed(x);
+	}
+	else if (handler == &CPU::handle_trint<&CPU::read_trint>)
+	{
+		Reg reg = trint(x, false);
+		_jit.load16(Reg::rsi, memory_at(addr + 1));
+		load_trint_at(reg, Reg::rsi);
+		changed(x);
+	}
+	else if (handler == &CPU::handle_trint<&CPU::write_trint>)
+	{
+		// from the register file, so the Trint only has to be split up once
+		write_back(slot_of(x) < _slots.size() ? slot_of(x) : 0);
+		_jit.load16(Reg::rsi, memory_at(addr + 1));
+		for (size_t k = 0; k < 3; k++)
+		{
+			_jit.load16(Reg::rcx, trint_digit(x, k));
+			_jit.store16(memory_at(Reg::rsi), Reg::rcx);
+			if (k < 2)
+			{
+				next_address(Reg::rsi);
+			}
+		}
+	}
+	else if (handler == &CPU::handle_trint_pair<&CPU::add_trints>)
+	{
+		Reg value = trint(y, true);
+		Reg reg = trint(x, true, y);
+		_jit.add(reg, value);
+		wrap_trint(reg);
+		changed(x);
+	}
+	else if (handler == &CPU::handle_trint<&CPU::add_num_to_trint>)
+	{
+		Reg reg = trint(x, true);
+		load_trint(Reg::rsi, memory_at(addr + 1), memory_at(addr + 2), memory_at(addr + 3));
+		_jit.add(reg, Reg::rsi);
+		wrap_trint(reg);
+		changed(x);
+	}
+	else if (handler == &CPU::handle_trint<&CPU::inc_trint> or handler == &CPU::handle_trint<&CPU::dec_trint>)
+	{
+		Reg reg = trint(x, true);
+		_jit.add(reg, handler == &CPU::handle_trint<&CPU::inc_trint> ? 1 : -1);
+		wrap_trint(reg);
+		changed(x);
+	}
+	else if (handler == &CPU::handle_trint<&CPU::flip_trint>)
+	{
+		_jit.neg(trint(x, true));
+		changed(x);
+	}
+	else if (handler == &CPU::handle_trint<&CPU::abs_trint>)
+	{
+		Reg reg = trint(x, true);
+		_jit.mov(Reg::rax, reg);
+		_jit.neg(Reg::rax);
+		_jit.test(reg, reg);
+		_jit.cmov(Condition::l, reg, Reg::rax);
+		changed(x);
+	}
+	else if (handler == &CPU::handle_trint_pair<&CPU::compare_trints>)
+	{
+		Reg value = trint(y, true);
+		compare(trint(x, true, y), value);
+	}
+	else if (handler == &CPU::handle_trint<&CPU::compare_trint_to_num>)
+	{
+		Reg reg = trint(x, true);
+		load_trint(Reg::rsi, memory_at(addr + 1), memory_at(addr + 2), memory_at(addr + 3));
+		compare(reg, Reg::rsi);
+	}
+	else if (handler == &CPU::handle_trint_pair<&CPU::swap_trints>)
+	{
+		// nothing to do but swap which host register holds which
+		trint(y, true);
+		trint(x, true, y);
+		size_t x_slot = slot_of(x);
+		size_t y_slot = slot_of(y);
+		std::swap(_slots[x_slot].trint, _slots[y_slot].trint);
+		changed(x);
+		changed(y);
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+bool JitCompiler::compile_tryte_op(CPU::BlockOp const& op)
+{
+	CPU::DecodedInstr const& decoded = *op.decoded;
+	auto handler = decoded.handler;
+	if (decoded.x == nullptr)
+	{
+		return false;
+	}
+	Jit::Mem x = field(decoded.x);
+	Jit::Mem y = decoded.y == nullptr ? x : field(decoded.y);
+	int64_t addr = Tryte::get_int(op.addr);
+
+	// Tryte registers are worked on in place, so the Trint registers they are part of can't be
+	// held in host registers meanwhile
+	auto release_operands = [this, &decoded]() {
+		release(decoded.x);
+		release(decoded.y);
+	};
+
+	if (handler == &CPU::handle_tryte_pair<&CPU::set_tryte>)
+	{
+		release_operands();
+		_jit.load16(Reg::rax, y);
+		_jit.store16(x, Reg::rax);
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::set_tryte_to_num>)
+	{
+		release_operands();
+		_jit.load16(Reg::rax, memory_at(addr + 1));
+		_jit.store16(x, Reg::rax);
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::read_tryte>)
+	{
+		release_operands();
+		_jit.load16(Reg::rax, memory_at(addr + 1));
+		_jit.load16(Reg::rax, memory_at(Reg::rax));
+		_jit.store16(x, Reg::rax);
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::write_tryte>)
+	{
+		release_operands();
+		_jit.load16(Reg::rax, memory_at(addr + 1));
+		_jit.load16(Reg::rcx, x);
+		_jit.store16(memory_at(Reg::rax), Reg::rcx);
+	}
+	else if (handler == &CPU::handle_tryte_pair<&CPU::add_trytes>)
+	{
+		// the sum wrapped into X, and the carry into Y and the carry flag
+		release_operands();
+		_jit.load16(Reg::rsi, x);
+		_jit.load16(Reg::rax, y);
+		_jit.add(Reg::rsi, Reg::rax);
+		_jit.mov(Reg::rdx, 0);
+		_jit.mov(Reg::r8, 1);
+		_jit.mov(Reg::r9, -1);
+		_jit.lea(Reg::rcx, { Reg::rsi, -19683 });
+		_jit.cmp(Reg::rsi, 9841);
+		_jit.cmov(Condition::g, Reg::rsi, Reg::rcx);
+		_jit.cmov(Condition::g, Reg::rdx, Reg::r8);
+		_jit.lea(Reg::rcx, { Reg::rsi, 19683 });
+		_jit.cmp(Reg::rsi, -9841);
+		_jit.cmov(Condition::l, Reg::rsi, Reg::rcx);
+		_jit.cmov(Condition::l, Reg::rdx, Reg::r9);
+		_jit.store16(x, Reg::rsi);
+		_jit.store16(y, Reg::rdx);
+		_jit.store16(field(&_cpu._flags.carry), Reg::rdx);
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::add_num_to_tryte>)
+	{
+		release_operands();
+		_jit.load16(Reg::rsi, x);
+		_jit.load16(Reg::rax, memory_at(addr + 1));
+		_jit.add(Reg::rsi, Reg::rax);
+		wrap_tryte(Reg::rsi);
+		_jit.store16(x, Reg::rsi);
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::inc_tryte> or handler == &CPU::handle_tryte<&CPU::dec_tryte>)
+	{
+		release_operands();
+		_jit.load16(Reg::rsi, x);
+		_jit.add(Reg::rsi, handler == &CPU::handle_tryte<&CPU::inc_tryte> ? 1 : -1);
+		wrap_tryte(Reg::rsi);
+		_jit.store16(x, Reg::rsi);
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::flip_tryte>)
+	{
+		release_operands();
+		_jit.load16(Reg::rsi, x);
+		_jit.neg(Reg::rsi);
+		_jit.store16(x, Reg::rsi);
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::abs_tryte>)
+	{
+		release_operands();
+		_jit.load16(Reg::rsi, x);
+		_jit.mov(Reg::rax, Reg::rsi);
+		_jit.neg(Reg::rax);
+		_jit.test(Reg::rsi, Reg::rsi);
+		_jit.cmov(Condition::l, Reg::rsi, Reg::rax);
+		_jit.store16(x, Reg::rsi);
+	}
+	else if (handler == &CPU::handle_tryte_pair<&CPU::compare_trytes>)
+	{
+		release_operands();
+		_jit.load16(Reg::rsi, x);
+		_jit.load16(Reg::rdi, y);
+		compare(Reg::rsi, Reg::rdi);
+	}
+	else if (handler == &CPU::handle_tryte<&CPU::compare_tryte_to_num>)
+	{
+		release_operands();
+		_jit.load16(Reg::rsi, x);
+		_jit.load16(Reg::rdi, memory_at(addr + 1));
+		compare(Reg::rsi, Reg::rdi);
+	}
+	else if (handler == &CPU::handle_tryte_pair<&CPU::swap_trytes>)
+	{
+		release_operands();
+		_jit.load16(Reg::rsi, x);
+		_jit.load16(Reg::rdi, y);
+		_jit.store16(x, Reg::rdi);
+		_jit.store16(y, Reg::rsi);
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+bool JitCompiler::compile_jump(CPU::BlockOp const& op)
+{
+	auto handler = op.decoded->handler;
+	int64_t addr = Tryte::get_int(op.addr);
+	Reg const target = Reg::rdi;
+	Condition taken;
+	if (handler == &CPU::handle<&CPU::jump>)
+	{
+		_ticks += 1;
+		_jit.load16(target, memory_at(addr + 1));
+		exit(&target, nullptr, op.instr);
+		return true;
+	}
+	else if (handler == &CPU::handle<&CPU::jump_if_zero>)
+	{
+		taken = Condition::e;
+	}
+	else if (handler == &CPU::handle<&CPU::jump_if_neg>)
+	{
+		taken = Condition::l;
+	}
+	else if (handler == &CPU::handle<&CPU::jump_if_pos>)
+	{
+		taken = Condition::g;
+	}
+	else
+	{
+		return false;
+	}
+
+	// the next instruction is the jump's address operand if taken, or the one after the jump
+	if (_compare_in_reg)
+	{
+		_jit.test(compare_reg, compare_reg);
+	}
+	else
+	{
+		_jit.cmp16(field(&_cpu._flags.compare), 0);
+	}
+	_jit.load16(target, memory_at(addr + 1));
+	// (op.next is wherever the jump went when the block was recorded)
+	_jit.mov(Reg::rsi, Tryte::get_int(Tryte(addr + 2)));
+	_jit.cmov(Jit::inverse(taken), target, Reg::rsi);
+	_ticks += 1;
+	exit(&target, nullptr, op.instr);
+	return true;
+}
+void JitCompiler::compile_call(size_t i)
+{
+	// the handler sees the CPU exactly as the interpreter leaves it
+	CPU::BlockOp const& op = _block[i];
+	sync();
+	_jit.store16(field(&_cpu._i_ptr), Tryte::get_int(op.addr));
+	_jit.store16(field(&_cpu._instr), Tryte::get_int(op.fused != nullptr ? _block[i + 1].instr : op.instr));
+	_jit.mov(Reg::rdi, cpu_reg);
+	_jit.mov(Reg::rsi, reinterpret_cast<int64_t>(&op));
+	_jit.mov(Reg::rax, reinterpret_cast<int64_t>(&CPU::jit_call));
+	_jit.call(Reg::rax);
+	_ticks = op.fused != nullptr ? 2 : 1;
+}
+
+void JitCompiler::compile()
+{
+	_jit.begin();
+	_epilogue = _jit.new_label();
+
+	// save the registers the caller expects kept, and keep the stack 16 byte aligned for calls
+	std::array<Reg, 6> const saved = { Reg::rbp, Reg::rbx, Reg::r12, Reg::r13, Reg::r14, Reg::r15 };
+	for (Reg reg : saved)
+	{
+		_jit.push(reg);
+	}
+	_jit.sub(Reg::rsp, 8);
+	_jit.mov(cpu_reg, reinterpret_cast<int64_t>(&_cpu));
+	_jit.mov(memory_reg, reinterpret_cast<int64_t>(&_cpu._memory[0]));
+
+	for (size_t i = 0; i < _block.size(); i++)
+	{
+		CPU::BlockOp const& op = _block[i];
+		bool last = i + 1 == _block.size();
+		// a jump can only be the last op, and leaves the block itself
+		if (last and compile_jump(op))
+		{
+			break;
+		}
+		if (compile_inline(op))
+		{
+			// a compare fused with the jump after it is compiled as two ops
+			_ticks += 1;
+			if (last)
+			{
+				exit(nullptr, &op.next, op.instr);
+			}
+			continue;
+		}
+
+		compile_call(i);
+		if (last or op.fused != nullptr)
+		{
+			// the handler has set the instruction pointer
+			_jit.add64(field(&_cpu._clock), _ticks);
+			_jit.jump(_epilogue);
+			break;
+		}
+		// carry on only if the CPU is still on, and execution fell through to the next instruction
+		Jit::Label next = _jit.new_label();
+		Jit::Label leave = _jit.new_label();
+		_jit.cmp8(field(&_cpu._on), 0);
+		_jit.jump_if(Condition::e, leave);
+		_jit.cmp16(field(&_cpu._i_ptr), Tryte::get_int(op.next));
+		_jit.jump_if(Condition::e, next);
+		_jit.bind(leave);
+		_jit.add64(field(&_cpu._clock), _ticks);
+		_jit.jump(_epilogue);
+		_jit.bind(next);
+	}
+
+	_jit.bind(_epilogue);
+	_jit.add(Reg::rsp, 8);
+	for (size_t i = saved.size(); i-- > 0;)
+	{
+		_jit.pop(saved[i]);
+	}
+	_jit.ret();
+}
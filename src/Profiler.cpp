@@ -0,0 +1,144 @@
+#include "Profiler.h"
+#include "Tryte.h"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <numeric>
+
+Profiler::Profiler()
+{
+	_families.fill({ 0, 0 });
+	_addresses.assign(19683, { 0, 0 });
+	_instrs.assign(19683, 0);
+}
+
+void Profiler::record(int16_t instr, int16_t addr, uint64_t ns)
+{
+	Counter& family = _families[(instr + 9841) / 729];
+	family.count += 1;
+	family.ns += ns;
+	Counter& address = _addresses[addr + 9841];
+	address.count += 1;
+	address.ns += ns;
+	_instrs[addr + 9841] = instr;
+}
+Profiler::Counter const& Profiler::address(int16_t addr) const
+{
+	return _addresses[addr + 9841];
+}
+void Profiler::set_source_map(std::unique_ptr<SourceMap> source_map)
+{
+	_source_map = std::move(source_map);
+}
+
+void Profiler::report(std::ostream& out, size_t top_addresses) const
+{
+	uint64_t total_count = 0;
+	uint64_t total_ns = 0;
+	for (Counter const& family : _families)
+	{
+		total_count += family.count;
+		total_ns += family.ns;
+	}
+	auto percent = [total_ns](uint64_t ns) { return total_ns == 0 ? 0.0 : 100.0 * ns / total_ns; };
+
+	out << "Profile: " << total_count << " instructions, " << std::fixed << std::setprecision(3)
+		<< total_ns / 1e6 << " ms\n";
+
+	// opcode families, by time
+	std::vector<size_t> families(_families.size());
+	std::iota(families.begin(), families.end(), 0);
+	std::sort(families.begin(), families.end(), [this](size_t x, size_t y) { return _families[x].ns > _families[y].ns; });
+	out << "Family         Count     Time (ms)   Time %  ns/instr\n";
+	for (size_t i : families)
+	{
+		Counter const& family = _families[i];
+		if (family.count == 0)
+		{
+			continue;
+		}
+		std::string name = Tryte::septavingt_string(Tryte(static_cast<int64_t>(i) * 729 - 9477)).substr(0, 1) + "XX";
+		out << std::left << std::setw(7) << name << std::right
+			<< std::setw(12) << family.count
+			<< std::setw(14) << std::setprecision(3) << family.ns / 1e6
+			<< std::setw(9) << std::setprecision(1) << percent(family.ns)
+			<< std::setw(10) << std::setprecision(1) << static_cast<double>(family.ns) / family.count << '\n';
+	}
+
+	if (_source_map)
+	{
+		report_ranges(out, "Function", false, top_addresses);
+		report_ranges(out, "Line", true, top_addresses);
+	}
+
+	// hottest addresses
+	std::vector<size_t> addresses;
+	for (size_t i = 0; i < _addresses.size(); i++)
+	{
+		if (_addresses[i].count > 0)
+		{
+			addresses.push_back(i);
+		}
+	}
+	size_t shown = std::min(top_addresses, addresses.size());
+	std::partial_sort(addresses.begin(), addresses.begin() + shown, addresses.end(),
+		[this](size_t x, size_t y) { return _addresses[x].ns > _addresses[y].ns; });
+	out << "Address  Instr        Count     Time (ms)   Time %" << (_source_map ? "  Source" : "") << "\n";
+	for (size_t k = 0; k < shown; k++)
+	{
+		size_t i = addresses[k];
+		Counter const& address = _addresses[i];
+		out << std::left << std::setw(9) << Tryte::septavingt_string(Tryte(static_cast<int64_t>(i) - 9841))
+			<< std::setw(6) << Tryte::septavingt_string(Tryte(_instrs[i])) << std::right
+			<< std::setw(12) << address.count
+			<< std::setw(14) << std::setprecision(3) << address.ns / 1e6
+			<< std::setw(9) << std::setprecision(1) << percent(address.ns);
+		SourceMap::Range const* line = _source_map ? _source_map->line(static_cast<int64_t>(i) - 9841) : nullptr;
+		if (line != nullptr)
+		{
+			out << "  " << line->name << ':' << line->line;
+		}
+		out << '\n';
+	}
+	out << std::defaultfloat;
+}
+void Profiler::report_ranges(std::ostream& out, std::string const& title, bool by_line, size_t top) const
+{
+	uint64_t total_ns = 0;
+	std::map<std::string, Counter> ranges;
+	for (size_t i = 0; i < _addresses.size(); i++)
+	{
+		Counter const& address = _addresses[i];
+		total_ns += address.ns;
+		if (address.count == 0)
+		{
+			continue;
+		}
+		int16_t addr = static_cast<int64_t>(i) - 9841;
+		SourceMap::Range const* range = by_line ? _source_map->line(addr) : _source_map->function(addr);
+		std::string name = range == nullptr ? "(unmapped)"
+			: (by_line ? range->name + ':' + std::to_string(range->line) : range->name);
+		Counter& counter = ranges[name];
+		counter.count += address.count;
+		counter.ns += address.ns;
+	}
+
+	std::vector<std::pair<std::string, Counter>> sorted(ranges.begin(), ranges.end());
+	size_t shown = std::min(top, sorted.size());
+	std::partial_sort(sorted.begin(), sorted.begin() + shown, sorted.end(),
+		[](auto const& x, auto const& y) { return x.second.ns > y.second.ns; });
+	size_t width = title.size();
+	for (size_t k = 0; k < shown; k++)
+	{
+		width = std::max(width, sorted[k].first.size());
+	}
+	out << std::left << std::setw(width) << title << "        Count     Time (ms)   Time %\n";
+	for (size_t k = 0; k < shown; k++)
+	{
+		Counter const& counter = sorted[k].second;
+		out << std::left << std::setw(width) << sorted[k].first << std::right
+			<< std::setw(13) << counter.count
+			<< std::setw(14) << std::setprecision(3) << counter.ns / 1e6
+			<< std::setw(9) << std::setprecision(1) << (total_ns == 0 ? 0.0 : 100.0 * counter.ns / total_ns) << '\n';
+	}
+}
@@ -0,0 +1,147 @@
+#include "ReplayLog.h"
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+std::string const ReplayLog::header = std::string("TRIREPL") + '\x01';
+
+ReplayLog::ReplayLog(std::string const& filename, Mode mode)
+	: _mode(mode), _clock(0), _pos(0), _has_next(false), _next_kind(Event::input), _next_value(0)
+{
+	if (_mode == Mode::record)
+	{
+		_record_file.open(filename, std::ios::binary);
+		_record_file.write(header.data(), header.size());
+		if (!_record_file)
+		{
+			throw std::runtime_error("Could not write replay log " + filename + ".\n");
+		}
+		return;
+	}
+
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		throw std::runtime_error("Could not open replay log " + filename + ".\n");
+	}
+	_log.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if (_log.size() < header.size() or std::string(_log.begin(), _log.begin() + header.size()) != header)
+	{
+		throw std::runtime_error(filename + " is not a replay log.\n");
+	}
+	_pos = header.size();
+	read_next();
+}
+
+bool ReplayLog::replaying() const
+{
+	return _mode == Mode::replay;
+}
+
+void ReplayLog::record(Event kind, uint64_t clock, int64_t value)
+{
+	_record_file.put(static_cast<char>(kind));
+	write_varint(clock - _clock);
+	// zigzag: small negative values stay small
+	write_varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+	_clock = clock;
+}
+void ReplayLog::flush()
+{
+	if (_mode == Mode::record)
+	{
+		_record_file.flush();
+	}
+}
+void ReplayLog::write_varint(uint64_t n)
+{
+	while (n >= 0x80)
+	{
+		_record_file.put(static_cast<char>((n & 0x7f) | 0x80));
+		n >>= 7;
+	}
+	_record_file.put(static_cast<char>(n));
+}
+
+bool ReplayLog::next(Event kind, uint64_t clock, int64_t& value)
+{
+	if (!_has_next or _next_kind != kind or _clock != clock)
+	{
+		return false;
+	}
+	value = _next_value;
+	read_next();
+	return true;
+}
+int64_t ReplayLog::expect(Event kind, uint64_t clock)
+{
+	int64_t value = 0;
+	if (!next(kind, clock, value))
+	{
+		std::string wanted = kind == Event::input ? "console input" : kind == Event::interrupt ? "an interrupt" : "a WAIT";
+		throw std::runtime_error("Replay wanted " + wanted + " at clock " + std::to_string(clock)
+			+ (_has_next ? ", but the log's next event is at clock " + std::to_string(_clock) : ", but the log has run out")
+			+ " - the program isn't running as it did when recorded.\n");
+	}
+	return value;
+}
+bool ReplayLog::finished() const
+{
+	return !_has_next;
+}
+
+void ReplayLog::read_next()
+{
+	_has_next = _pos < _log.size();
+	if (!_has_next)
+	{
+		return;
+	}
+	_next_kind = static_cast<Event>(_log[_pos++]);
+	if (_next_kind != Event::input and _next_kind != Event::interrupt and _next_kind != Event::wait)
+	{
+		throw std::runtime_error("Replay log is corrupt: unknown event at byte " + std::to_string(_pos - 1) + ".\n");
+	}
+	size_t start = _pos - 1;
+	_clock += read_varint();
+	uint64_t zigzag = read_varint();
+	_next_value = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+
+	// the CPU and console take values straight from the log, so anything they couldn't have
+	// recorded is rejected here
+	bool in_range = true;
+	switch (_next_kind)
+	{
+		case Event::input:
+			in_range = _next_value >= std::numeric_limits<char>::min() and _next_value <= std::numeric_limits<char>::max();
+			break;
+		case Event::interrupt:
+			in_range = _next_value >= -13 and _next_value <= 13;
+			break;
+		case Event::wait:
+			in_range = _next_value >= 0;
+			break;
+	}
+	if (!in_range)
+	{
+		throw std::runtime_error("Replay log is corrupt: value out of range in the event at byte " + std::to_string(start) + ".\n");
+	}
+}
+uint64_t ReplayLog::read_varint()
+{
+	uint64_t n = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7)
+	{
+		if (_pos == _log.size())
+		{
+			throw std::runtime_error("Replay log is cut short.\n");
+		}
+		uint8_t byte = _log[_pos++];
+		n |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return n;
+		}
+	}
+	throw std::runtime_error("Replay log is corrupt: number too long at byte " + std::to_string(_pos) + ".\n");
+}
@@ -0,0 +1,59 @@
+#include "SourceMap.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+SourceMap::SourceMap(std::string const& filename)
+{
+	std::ifstream map_file(filename);
+	if (!map_file)
+	{
+		throw std::runtime_error("Could not open source map " + filename + ".\n");
+	}
+
+	std::string text;
+	while (std::getline(map_file, text))
+	{
+		std::istringstream entry(text);
+		std::string kind;
+		Range range = { 0, 0, "", 0 };
+		entry >> kind;
+		if (kind == "fn")
+		{
+			entry >> range.name >> range.start >> range.end;
+		}
+		else if (kind == "line")
+		{
+			entry >> range.name >> range.line >> range.start >> range.end;
+		}
+		else
+		{
+			continue;
+		}
+		if (!entry)
+		{
+			throw std::runtime_error("Invalid entry in source map " + filename + ": " + text + "\n");
+		}
+		(kind == "fn" ? _functions : _lines).push_back(range);
+	}
+}
+
+SourceMap::Range const* SourceMap::find(std::vector<Range> const& ranges, int16_t addr)
+{
+	for (Range const& range : ranges)
+	{
+		if (addr >= range.start and addr < range.end)
+		{
+			return &range;
+		}
+	}
+	return nullptr;
+}
+SourceMap::Range const* SourceMap::function(int16_t addr) const
+{
+	return find(_functions, addr);
+}
+SourceMap::Range const* SourceMap::line(int16_t addr) const
+{
+	return find(_lines, addr);
+}
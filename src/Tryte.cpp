@@ -2,68 +2,286 @@
 #include <ciso646> // for and & or in Visual Studio
 #include <cstdint> // for int16_t
 #include <cassert> // for assert
-#include <algorithm> // for std::reverse (reverse string), std::min
+#include <algorithm> // for std::reverse (reverse string), std::sort
 #include <string> // for std::string
-#include <vector> // for std::vector
 #include <array> // for std::array
 #include <stdexcept> // for std::runtime_error
 #include <iostream> // for std::ostream
+#include <cstring> // for std::memcpy
 
 const std::string Tryte::ternary_chars = "-0+";
 const std::string Tryte::septavingt_chars = "MLKJIHGFEDCBA0abcdefghijklm";
 
-std::string Tryte::ternary_string(Tryte const& t)
+std::array<uint32_t, 19683> const& Tryte::packed_trits_table()
 {
-    std::string output(9, '0');
-    std::array<int16_t, 9> tern_rep = Tryte::ternary_array(t);
+    // built on first use, so it is safe to use from other static initialisers
+    static std::array<uint32_t, 19683> const table = []()
+    {
+        // count up from -9841 (all trits -) in balanced ternary, keeping the masks up to date,
+        // rather than dividing out the trits of every value
+        std::array<uint32_t, 19683> output;
+        uint32_t positive = 0;
+        uint32_t negative = 0x1FF;
+        for (size_t index = 0; index < 19683; index++)
+        {
+            output[index] = positive | (negative << 16);
+            for (size_t i = 0; i < 9; i++)
+            {
+                uint32_t bit = 1u << i;
+                if (positive & bit)
+                {
+                    // + rolls over to -, and carry into the next trit
+                    positive &= ~bit;
+                    negative |= bit;
+                }
+                else
+                {
+                    // - goes to 0, or 0 goes to +
+                    if (negative & bit)
+                    {
+                        negative &= ~bit;
+                    }
+                    else
+                    {
+                        positive |= bit;
+                    }
+                    break;
+                }
+            }
+        }
+        return output;
+    }();
+    return table;
+}
+std::array<int16_t, 512> const& Tryte::mask_values_table()
+{
+    static std::array<int16_t, 512> const table = []()
+    {
+        std::array<int16_t, 512> output;
+        for (size_t mask = 0; mask < 512; mask++)
+        {
+            int16_t value = 0;
+            int16_t power_of_3 = 1;
+            for (size_t i = 0; i < 9; i++)
+            {
+                if (mask & (1u << i))
+                {
+                    value += power_of_3;
+                }
+                power_of_3 *= 3;
+            }
+            output[mask] = value;
+        }
+        return output;
+    }();
+    return table;
+}
+uint16_t Tryte::positive_trits(Tryte const& t)
+{
+    return packed_trits_table()[t.m_tryte + 9841] & 0x1FF;
+}
+uint16_t Tryte::negative_trits(Tryte const& t)
+{
+    return packed_trits_table()[t.m_tryte + 9841] >> 16;
+}
+Tryte Tryte::from_trit_masks(uint16_t positive, uint16_t negative)
+{
+    Tryte output;
+    output.m_tryte = mask_values_table()[positive & 0x1FF] - mask_values_table()[negative & 0x1FF];
+    return output;
+}
 
-    // loop over the ternary array and construct the string
-    for (int i = 0; i < 9; i++)
+std::array<uint32_t, 19683> const& Tryte::septavingt_text_table()
+{
+    static std::array<uint32_t, 19683> const table = []()
     {
-        output[i] = Tryte::ternary_chars[1 + tern_rep[i]];
-    }
+        std::array<uint32_t, 19683> output;
+        for (int16_t d0 = -13; d0 <= 13; d0++)
+        {
+            for (int16_t d1 = -13; d1 <= 13; d1++)
+            {
+                for (int16_t d2 = -13; d2 <= 13; d2++)
+                {
+                    // copied in as bytes, so the text comes out in order whatever the byte order
+                    char const text[4] = { Tryte::septavingt_chars[d0 + 13], Tryte::septavingt_chars[d1 + 13],
+                        Tryte::septavingt_chars[d2 + 13], '\0' };
+                    std::memcpy(&output[729 * d0 + 27 * d1 + d2 + 9841], text, 4);
+                }
+            }
+        }
+        return output;
+    }();
+    return table;
+}
+std::array<uint32_t, 64> const& Tryte::trit_triple_table()
+{
+    static std::array<uint32_t, 64> const table = []()
+    {
+        std::array<uint32_t, 64> output;
+        for (size_t masks = 0; masks < 64; masks++)
+        {
+            // most significant trit (bit 2 of the masks) first
+            char text[4] = { '\0', '\0', '\0', '\0' };
+            for (size_t i = 0; i < 3; i++)
+            {
+                int trit = static_cast<int>((masks >> (2 - i)) & 1) - static_cast<int>((masks >> (5 - i)) & 1);
+                text[i] = Tryte::ternary_chars[trit + 1];
+            }
+            std::memcpy(&output[masks], text, 4);
+        }
+        return output;
+    }();
+    return table;
+}
+std::array<int8_t, 256> const& Tryte::septavingt_digit_table()
+{
+    static std::array<int8_t, 256> const table = []()
+    {
+        std::array<int8_t, 256> output;
+        output.fill(-128);
+        for (size_t i = 0; i < Tryte::septavingt_chars.size(); i++)
+        {
+            output[static_cast<unsigned char>(Tryte::septavingt_chars[i])] = static_cast<int8_t>(i) - 13;
+        }
+        return output;
+    }();
+    return table;
+}
+std::array<int8_t, 256> const& Tryte::trit_digit_table()
+{
+    static std::array<int8_t, 256> const table = []()
+    {
+        std::array<int8_t, 256> output;
+        output.fill(-128);
+        for (size_t i = 0; i < Tryte::ternary_chars.size(); i++)
+        {
+            output[static_cast<unsigned char>(Tryte::ternary_chars[i])] = static_cast<int8_t>(i) - 1;
+        }
+        return output;
+    }();
+    return table;
+}
+
+std::string Tryte::ternary_string(Tryte const& t)
+{
+    std::string output(9, '0');
+    Tryte::ternary_text(&t, 1, &output[0]);
     return output;
 }
 std::string Tryte::septavingt_string(Tryte const& t)
 {
     std::string output(3, '0');
-    std::array<int16_t, 3> sept_rep = Tryte::septavingt_array(t);
+    Tryte::septavingt_text(&t, 1, &output[0]);
+    return output;
+}
+char* Tryte::septavingt_text(Tryte const* trytes, size_t count, char* output, char separator)
+{
+    std::array<uint32_t, 19683> const& table = Tryte::septavingt_text_table();
+    if (separator != '\0')
+    {
+        // the separator goes in each entry's spare fourth byte
+        char const separator_text[4] = { '\0', '\0', '\0', separator };
+        uint32_t separator_bits;
+        std::memcpy(&separator_bits, separator_text, 4);
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t text = table[trytes[i].m_tryte + 9841] | separator_bits;
+            std::memcpy(output + 4 * i, &text, 4);
+        }
+        return output + 4 * count;
+    }
 
-    // loop over septavingt array and construct the string
-    for (int i = 0; i < 3; i++)
+    // stores 3 chars apart - each one's spare byte is overwritten by the next, so only the
+    // last has to stop at 3
+    if (count == 0)
     {
-        output[i] = Tryte::septavingt_chars[13 + sept_rep[i]];
+        return output;
     }
-    return output;
+    for (size_t i = 0; i + 1 < count; i++)
+    {
+        std::memcpy(output + 3 * i, &table[trytes[i].m_tryte + 9841], 4);
+    }
+    std::memcpy(output + 3 * (count - 1), &table[trytes[count - 1].m_tryte + 9841], 3);
+    return output + 3 * count;
 }
-std::array<int16_t, 9> Tryte::ternary_array(Tryte const& t)
+char* Tryte::ternary_text(Tryte const* trytes, size_t count, char* output, char separator)
 {
-    std::array<int16_t, 9> output;
-    // ensure dividend is positive (restore sign later)
-    int16_t dividend = t.m_tryte > 0 ? t.m_tryte : -t.m_tryte;
-    int16_t remainder = 0;
-
-    for (size_t i = 0; i < 9; i++)
+    std::array<uint32_t, 19683> const& packed_trits = Tryte::packed_trits_table();
+    std::array<uint32_t, 64> const& triples = Tryte::trit_triple_table();
+    size_t stride = separator != '\0' ? 10 : 9;
+    for (size_t i = 0; i < count; i++)
     {
-        remainder = dividend % 3;
-        dividend = dividend / 3;
-        // handle shift for balanced ternary representation
-        if (remainder == 2)
+        // three trits at a time, from their slices of the + and - masks, most significant first.
+        // As above, the first two stores' spare bytes are overwritten by the next.
+        uint32_t packed = packed_trits[trytes[i].m_tryte + 9841];
+        char* text = output + stride * i;
+        std::memcpy(text, &triples[((packed >> 6) & 7) | ((packed >> 19) & 0x38)], 4);
+        std::memcpy(text + 3, &triples[((packed >> 3) & 7) | ((packed >> 16) & 0x38)], 4);
+        std::memcpy(text + 6, &triples[(packed & 7) | ((packed >> 13) & 0x38)], 3);
+        if (separator != '\0')
         {
-            dividend++;
-            remainder = -1;
+            text[9] = separator;
         }
-        // fill output array backwards (algorithm finds least significant digit first)
-        output[8 - i] = remainder;
     }
+    return output + stride * count;
+}
+size_t Tryte::parse_text(char const* text, size_t length, Tryte* output, size_t max_trytes)
+{
+    std::array<int8_t, 256> const& digits = Tryte::septavingt_digit_table();
+    std::array<int8_t, 256> const& trits = Tryte::trit_digit_table();
+    auto is_separator = [](char c) { return c == ' ' or c == '\n' or c == '\r' or c == '\t'; };
+    size_t pos = 0;
+    size_t count = 0;
 
-    // flip the sign back if necessary
-    if (t.m_tryte < 0)
+    while (count < max_trytes)
     {
-        for (auto &trit : output)
+        // find the next token
+        while (pos < length and is_separator(text[pos]))
+        {
+            pos++;
+        }
+        if (pos == length)
+        {
+            break;
+        }
+        size_t start = pos;
+        while (pos < length and !is_separator(text[pos]))
         {
-            trit = -trit;
+            pos++;
         }
+
+        int16_t value = 0;
+        if (pos - start == 3 or pos - start == 9)
+        {
+            // 3 septavingt digits (base 27) or 9 trits (base 3)
+            std::array<int8_t, 256> const& token_digits = pos - start == 3 ? digits : trits;
+            int16_t base = pos - start == 3 ? 27 : 3;
+            for (size_t i = start; i < pos; i++)
+            {
+                int16_t digit = token_digits[static_cast<unsigned char>(text[i])];
+                if (digit == -128)
+                {
+                    throw std::runtime_error("Invalid string for Tryte initialisation.");
+                }
+                value = base * value + digit;
+            }
+        }
+        // anything else reads as zero, as with operator>>
+        output[count].m_tryte = value;
+        count++;
+    }
+    return count;
+}
+std::array<int16_t, 9> Tryte::ternary_array(Tryte const& t)
+{
+    std::array<int16_t, 9> output;
+    uint16_t positive = Tryte::positive_trits(t);
+    uint16_t negative = Tryte::negative_trits(t);
+
+    // fill output array backwards (bit 0 is the least significant trit)
+    for (size_t i = 0; i < 9; i++)
+    {
+        output[8 - i] = ((positive >> i) & 1) - ((negative >> i) & 1);
     }
 
     return output;
@@ -71,17 +289,14 @@ std::array<int16_t, 9> Tryte::ternary_array(Tryte const& t)
 std::array<int16_t, 3> Tryte::septavingt_array(Tryte const& t)
 {
     std::array<int16_t, 3> output;
-    // First generate the ternary rep
-    std::array<int16_t, 9> tern = Tryte::ternary_array(t);
-    std::array<int16_t, 3> trits;
+    int16_t dividend = t.m_tryte;
 
+    // peel off balanced septavingtesmal digits (-13 <= x <= 13), least significant first
     for (size_t i = 0; i < 3; i++)
     {
-        // take a subarray of three trits
-        trits = {tern[3*i], tern[3*i + 1], tern[3*i + 2]};
-
-        // convert to decimal value between -13 and 13 inclusive.
-        output[i] = 9 * trits[0] + 3 * trits[1] + trits[2];
+        int16_t remainder = ((dividend % 27) + 40) % 27 - 13;
+        output[2 - i] = remainder;
+        dividend = (dividend - remainder) / 27;
     }
 
     return output;
@@ -154,45 +369,18 @@ int16_t Tryte::septavingt_string_to_int(std::string s_string)
 }
 int16_t Tryte::truncate_int(int64_t const& n)
 {
-    // make input positive; it's just easier
-    int64_t dividend = n > 0 ? n : -n;
-
-    int16_t remainder = 0;
-    std::vector<int16_t> values;
-    int16_t output = 0;
-    while (dividend != 0)
+    // keeping the lowest nine trits of n is just n mod 3^9, taken in the
+    // balanced range -9841 <= x <= 9841
+    int64_t output = n % 19683;
+    if (output > 9841)
     {
-        remainder = dividend % 27;
-        dividend = dividend / 27;
-        // handle shift for balanced septavingtesmal representation
-        if (remainder > 13)
-        {
-            dividend++;
-            remainder -= 27;
-        }
-        else if (remainder < -13)
-        {
-            dividend--;
-            remainder += 27;
-        }
-        values.push_back(remainder);
+        output -= 19683;
     }
-
-    // only need first three characters of septavingtesmal rep
-    size_t length = (values.size() > 3) ? 3 : values.size();
-
-    int16_t power_of_27 = 1;
-
-    for (size_t i = 0; i < length; i++)
+    else if (output < -9841)
     {
-        output += values[i] * power_of_27;
-        power_of_27 *= 27;
+        output += 19683;
     }
-
-    // fix minus sign, if necessary (advantage of balanced ternary)
-    if (n < 0) output = -output;
-
-    return output;
+    return static_cast<int16_t>(output);
 }
 std::array<int16_t, 2> Tryte::carry_handler(int16_t n)
 {
@@ -275,19 +463,13 @@ Tryte::Tryte(std::array<int16_t, 9>& tern_array)
     m_tryte = 0;
     for (size_t i = 0; i < 9; i++)
     {
-        m_tryte = powers_of_3[i] * tern_array[i];
+        m_tryte += powers_of_3[i] * tern_array[i];
     }
 }
-Tryte::Tryte(Tryte const& other)
-{
-    m_tryte = other.m_tryte;
-}
 
 Tryte& Tryte::operator++()
 {
-    int64_t x = this->m_tryte;
-    x++;
-    this->m_tryte = truncate_int(x);
+    this->m_tryte = (this->m_tryte == 9841) ? -9841 : this->m_tryte + 1;
     return *this;
 }
 Tryte Tryte::operator++(int)
@@ -298,9 +480,7 @@ Tryte Tryte::operator++(int)
 }
 Tryte& Tryte::operator--()
 {
-    int64_t x = this->m_tryte;
-    x--;
-    this->m_tryte = truncate_int(x);
+    this->m_tryte = (this->m_tryte == -9841) ? 9841 : this->m_tryte - 1;
     return *this;
 }
 Tryte Tryte::operator--(int)
@@ -348,15 +528,11 @@ Tryte Tryte::operator&(Tryte const& other) const
         - | - | - | -
         0 | - | 0 | 0
         + | - | 0 | +
-    */
-    std::array<int16_t, 9> this_array = Tryte::ternary_array(*this);
-    std::array<int16_t, 9> other_array = Tryte::ternary_array(other);
 
-    for (size_t i = 0; i < 9; i++)
-    {
-        this_array[i] = std::min(this_array[i], other_array[i]);
-    }
-    return Tryte(this_array);
+    A trit of the result is + only if both trits are +, and - if either trit is -.
+    */
+    return Tryte::from_trit_masks(Tryte::positive_trits(*this) & Tryte::positive_trits(other),
+        Tryte::negative_trits(*this) | Tryte::negative_trits(other));
 }
 Tryte& Tryte::operator&=(Tryte const& other)
 {
@@ -375,15 +551,11 @@ Tryte Tryte::operator|(Tryte const& other) const
         - | - | 0 | +
         0 | 0 | 0 | +
         + | + | + | +
-    */
-    std::array<int16_t, 9> this_array = Tryte::ternary_array(*this);
-    std::array<int16_t, 9> other_array = Tryte::ternary_array(other);
 
-    for (size_t i = 0; i < 9; i++)
-    {
-        this_array[i] = std::max(this_array[i], other_array[i]);
-    }
-    return Tryte(this_array);
+    A trit of the result is + if either trit is +, and - only if both trits are -.
+    */
+    return Tryte::from_trit_masks(Tryte::positive_trits(*this) | Tryte::positive_trits(other),
+        Tryte::negative_trits(*this) & Tryte::negative_trits(other));
 }
 Tryte& Tryte::operator|=(Tryte const& other)
 {
@@ -403,27 +575,17 @@ Tryte Tryte::operator^(Tryte const& other) const
         - | - | 0 | +
         0 | 0 | 0 | 0
         + | + | 0 | -
-    */
 
-    std::array<int16_t, 9> this_array = Tryte::ternary_array(*this);
-    std::array<int16_t, 9> other_array = Tryte::ternary_array(other);
+    Where both trits are nonzero, the result is - if they match and + otherwise.
+    */
+    uint16_t this_positive = Tryte::positive_trits(*this);
+    uint16_t this_negative = Tryte::negative_trits(*this);
+    uint16_t other_positive = Tryte::positive_trits(other);
+    uint16_t other_negative = Tryte::negative_trits(other);
 
-    for (size_t i = 0; i < 9; i++)
-    {
-        if (this_array[i] == 0 or other_array[i] == 0)
-        {
-            this_array[i] = 0;
-        }
-        else if (this_array[i] == other_array[i])
-        {
-            this_array[i] = -1;
-        }
-        else
-        {
-            this_array[i] = 1;
-        }
-    }
-    return Tryte(this_array);
+    uint16_t both_nonzero = (this_positive | this_negative) & (other_positive | other_negative);
+    uint16_t matching = (this_positive & other_positive) | (this_negative & other_negative);
+    return Tryte::from_trit_masks(both_nonzero & ~matching, matching);
 }
 Tryte& Tryte::operator^=(Tryte const& other)
 {
@@ -451,40 +613,24 @@ Tryte Tryte::operator~() const
         A | - | 0 | +
         -----------------
        ~A | + | 0 | -
+
+    Flipping every trit of a balanced ternary number just flips its sign.
     */
-   std::array<int16_t, 9> this_array = Tryte::ternary_array(*this);
-   for (size_t i = 0; i < 9; i++)
-   {
-       this_array[i] = -this_array[i];
-   }
-   return Tryte(this_array);
+    return -(*this);
 }
 
 Tryte Tryte::operator<<(uint16_t const& n) const
 {
     // tritshift left. New values at the right of the tryte are filled with zeroes.
-    std::array<int16_t, 9> this_array = Tryte::ternary_array(*this);
-    std::array<int16_t, 9> new_array;
-
     if (n >= 9)
     {
         // shifted completely to the left - or out of bounds
-        return Tryte("000");
+        return Tryte();
     }
     else
     {
-        uint16_t k = 9 - n;
-        for (size_t i = 0; i < k; i++)
-        {
-            new_array[i] = this_array[i + n];
-        }
-        // fill rest of array with zeroes
-        for (size_t i = k; i < n; i++)
-        {
-            new_array[i] = 0;
-        }
-        // build a new Tryte with this new array
-        return Tryte(new_array);
+        // trits shifted past the top of the masks are dropped by from_trit_masks
+        return Tryte::from_trit_masks(Tryte::positive_trits(*this) << n, Tryte::negative_trits(*this) << n);
     }    
 }
 Tryte& Tryte::operator<<=(uint16_t const& n)
@@ -495,27 +641,14 @@ Tryte& Tryte::operator<<=(uint16_t const& n)
 Tryte Tryte::operator>>(uint16_t const& n) const
 {
     // tritshift right. New values at the left of the tryte are filled with zeroes.
-    std::array<int16_t, 9> this_array = Tryte::ternary_array(*this);
-    std::array<int16_t, 9> new_array;
-
     if (n >= 9)
     {
         // shifted completely to the right - or out of bounds
-        return Tryte("000");
+        return Tryte();
     }
     else
     {
-        // fill new trits with zeroes
-        for (size_t i = 0; i < n; i++)
-        {
-            new_array[i] = 0;
-        }
-        for (size_t i = n; i < 9; i++)
-        {
-            new_array[i] = this_array[i - n];
-        }
-        // build a new Tryte with this new array
-        return Tryte(new_array);
+        return Tryte::from_trit_masks(Tryte::positive_trits(*this) >> n, Tryte::negative_trits(*this) >> n);
     }    
 }
 Tryte& Tryte::operator>>=(uint16_t const& n)
@@ -557,24 +690,9 @@ std::istream& operator>>(std::istream& is, Tryte& tryte)
 
 Tryte Tryte::operator+(Tryte const& other) const
 {
-    Tryte output("000");
-    std::array<int16_t, 3> this_array = Tryte::septavingt_array(*this);
-    std::array<int16_t, 3> other_array = Tryte::septavingt_array(other);
-    std::array<int16_t, 3> new_array = { 0, 0, 0 };
-    int16_t carry = 0;
-
-    // construct new array for the sum of Trytes
-    for (size_t i = 0; i < 3; i++)
-    {
-        std::array<int16_t, 2> carry_and_sum =
-            Tryte::carry_handler(this_array[2 - i] + other_array[2 - i] + carry);
-
-        carry = carry_and_sum[0];
-        new_array[2 - i] = carry_and_sum[1];
-    }
-
-    // construct output Tryte from new_array
-    output = 729 * new_array[0] + 27 * new_array[1] + new_array[2];
+    // add natively, then drop the carry by wrapping back into range
+    Tryte output;
+    output.m_tryte = Tryte::truncate_int(this->m_tryte + other.m_tryte);
     return output;
 }
 Tryte& Tryte::operator+=(Tryte const& other)
@@ -601,118 +719,49 @@ Tryte Tryte::operator-() const
 }
 Tryte Tryte::tritwise_add(Tryte const& t1, Tryte const& t2)
 {
-    std::array<int16_t, 9> t1_array = Tryte::ternary_array(t1);
-    std::array<int16_t, 9> t2_array = Tryte::ternary_array(t2);
-    std::array<int16_t, 9> new_array;
-    for (size_t i = 0; i < 9; i++)
-    {
-        new_array[i] = t1_array[i] + t2_array[i];
-        if (new_array[i] > 1)
-        {
-            new_array[i] -= 3;
-        }
-        if (new_array[i] < -1)
-        {
-            new_array[i] += 3;
-        }
-    }
-    return Tryte(new_array);
+    // each pair of trits is added mod 3: a trit plus zero is unchanged,
+    // + and + wraps round to -, and - and - wraps round to +
+    uint16_t t1_positive = Tryte::positive_trits(t1);
+    uint16_t t1_negative = Tryte::negative_trits(t1);
+    uint16_t t2_positive = Tryte::positive_trits(t2);
+    uint16_t t2_negative = Tryte::negative_trits(t2);
+    uint16_t t1_zero = ~(t1_positive | t1_negative);
+    uint16_t t2_zero = ~(t2_positive | t2_negative);
+
+    uint16_t positive = (t1_positive & t2_zero) | (t2_positive & t1_zero) | (t1_negative & t2_negative);
+    uint16_t negative = (t1_negative & t2_zero) | (t2_negative & t1_zero) | (t1_positive & t2_positive);
+    return Tryte::from_trit_masks(positive, negative);
 }
 Tryte Tryte::tritwise_mult(Tryte const& t1, Tryte const& t2)
 {
-    std::array<int16_t, 9> t1_array = Tryte::ternary_array(t1);
-    std::array<int16_t, 9> t2_array = Tryte::ternary_array(t2);
-    std::array<int16_t, 9> new_array;
-    for (size_t i = 0; i < 9; i++)
-    {
-        new_array[i] = t1_array[i] * t2_array[i];
-    }
-    return Tryte(new_array);
+    // the product of two trits is + if their signs match, - if they differ, and 0 otherwise
+    uint16_t t1_positive = Tryte::positive_trits(t1);
+    uint16_t t1_negative = Tryte::negative_trits(t1);
+    uint16_t t2_positive = Tryte::positive_trits(t2);
+    uint16_t t2_negative = Tryte::negative_trits(t2);
+
+    return Tryte::from_trit_masks((t1_positive & t2_positive) | (t1_negative & t2_negative),
+        (t1_positive & t2_negative) | (t1_negative & t2_positive));
 }
 std::array<Tryte, 2> Tryte::add_with_carry(Tryte const& t1, Tryte const& t2, Tryte const& carry)
 {
-    std::array<Tryte, 2> output = {0, 0};
-    std::array<int16_t, 3> t1_array = Tryte::septavingt_array(t1);
-    std::array<int16_t, 3> t2_array = Tryte::septavingt_array(t2);
-    std::array<int16_t, 3> carry_array = Tryte::septavingt_array(carry);
-    std::array<int16_t, 4> new_array = {0, 0, 0, 0};
-    int16_t new_carry = 0;
+    std::array<Tryte, 2> output;
+    int32_t sum = t1.m_tryte + t2.m_tryte + carry.m_tryte;
 
-    // construct new_array for the sum of Trytes
-    for (size_t i = 0; i < 3; i++)
-    {
-        std::array<int16_t, 2> carry_and_sum = 
-        Tryte::carry_handler(t1_array[2 - i] + t2_array[2 - i] + carry_array[2 - i] + new_carry);
-
-        new_carry = carry_and_sum[0];
-        new_array[3 - i] = carry_and_sum[1];
-    }
-    new_array[0] = new_carry;
-
-    // populate output Trytes using new_array 
-    output[0] = new_array[0];
-    output[1] = 729 * new_array[1] + 27 * new_array[2] + new_array[3];
+    // the low Tryte is the sum wrapped into range, the carry is whatever is left over
+    output[1].m_tryte = Tryte::truncate_int(sum);
+    output[0].m_tryte = static_cast<int16_t>((sum - output[1].m_tryte) / 19683);
 
     return output;
 }
 std::array<Tryte, 2> Tryte::mult(Tryte const& t1, Tryte const& t2)
 {
-    std::array<Tryte, 2> output = {0, 0};
-    std::array<int16_t, 3> a = Tryte::septavingt_array(t1);
-    std::array<int16_t, 3> b = Tryte::septavingt_array(t2);
-
-    // Basically want to perform long multiplcation
-    // in balanced septavingtesmal.
-    // want to do
-    //                         a0     a1     a2
-    //                   *     b0     b1     b2
-    // ----------------------------------------
-    // carry  a0.b0  a1.b0  a2.b0      0      0 : s0
-    //        carry  a0.b1  a1.b1  a2.b1      0 : s1
-    //               carry  a0.b2  a1.b2  a2.b2 : s2
-    // ----------------------------------------
-    //    n0     n1     n2     n3     n4     n5
-
-    // have to be careful to handle carries
-    int16_t carry = 0;
-
-    // create arrays to store intermediate results
-    std::array<std::array<int16_t, 6>, 3> s;
-    s[0] = {0, 0, 0, 0, 0, 0};
-    s[1] = {0, 0, 0, 0, 0, 0};
-    s[2] = {0, 0, 0, 0, 0, 0};
-    std::array<int16_t, 2> temp = {0, 0};
-    // and our final array
-    std::array<int16_t, 6> n = {0, 0, 0, 0, 0, 0};
-
-    // calculate s arrays
-    for (size_t i = 0; i < 3; i++)
-    {
-        // calculate s[i]
-        carry = 0;
-        for (size_t j = 0; j < 3; j++)
-        {
-            temp = Tryte::carry_handler(a[2 - j] * b[i] + carry);
-            carry = temp[0];
-            int16_t result = temp[1];
-            s[i][3 + i - j] += result;
-        }
-        s[i][i] = carry;
-    }
-    
-    // now need to sum those s arrays to produce n
-
-    carry = 0;
-    for (size_t k = 0; k < 6; k++)
-    {
-        temp = Tryte::carry_handler(s[0][5 - k] + s[1][5 - k] + s[2][5 - k] + carry);
-        carry = temp[0];
-        n[5 - k] = temp[1];
-    }
+    std::array<Tryte, 2> output;
+    // |t1 * t2| <= 9841^2, which comfortably fits in 18 trits (two Trytes)
+    int32_t product = static_cast<int32_t>(t1.m_tryte) * t2.m_tryte;
 
-    // populate output Trytes using n
-    output[0] = 729 * n[0] + 27 * n[1] + n[2];
-    output[1] = 729 * n[3] + 27 * n[4] + n[5];
+    output[1].m_tryte = Tryte::truncate_int(product);
+    output[0].m_tryte = static_cast<int16_t>((product - output[1].m_tryte) / 19683);
 
     return output; 
 }
@@ -737,28 +786,33 @@ int64_t Tryte::sign(Tryte const& t)
 }
 size_t Tryte::length(Tryte const& t)
 {
+    // position of the highest nonzero trit
     size_t output = 0;
-    std::array<int16_t, 9> tern_array = Tryte::ternary_array(t);
-    for (size_t i = 0; i < 9; i++)
+    uint16_t nonzero = Tryte::positive_trits(t) | Tryte::negative_trits(t);
+    while (nonzero != 0)
     {
-        if (tern_array[i] != 0 and output == 0)
-        {
-            output++;
-        }
-        else if (output != 0)
-        {
-            output++;
-        }
+        nonzero >>= 1;
+        output++;
     }
     return output;
 }
 std::array<Tryte, 2> Tryte::div(Tryte& t1, Tryte& t2)
 {
+    std::array<Tryte, 2> output;
     // if t2 == 0, throw an error
-    if (t2 == 0)
+    if (!Tryte::try_div(t1, t2, output))
     {
         throw std::runtime_error("Attempted to divide by zero.");
     }
+    return output;
+}
+
+bool Tryte::try_div(Tryte const& t1, Tryte const& t2, std::array<Tryte, 2>& output)
+{
+    if (t2 == 0)
+    {
+        return false;
+    }
 
     // compute 'size' of t1 and t2 - number of digits
     int64_t size1 = Tryte::length(t1);
@@ -767,8 +821,8 @@ std::array<Tryte, 2> Tryte::div(Tryte& t1, Tryte& t2)
     // if size2 > size1, stop here
     if (size2 > size1)
     {
-        std::array<Tryte, 2> output = {0, t1};
-        return output;
+        output = {0, t1};
+        return true;
     }
 
     int16_t shift = size1 - size2;
@@ -820,7 +874,7 @@ std::array<Tryte, 2> Tryte::div(Tryte& t1, Tryte& t2)
         }
     }
     
-    std::array<Tryte, 2> output = {quotient, remainder};
-    return output;
+    output = {quotient, remainder};
+    return true;
 
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(size_t thread_count)
+{
+	_thread_count = thread_count != 0 ? thread_count : std::max(1u, std::thread::hardware_concurrency());
+	for (size_t i = 0; i < _thread_count; i++)
+	{
+		_queues.push_back(std::make_unique<Queue>());
+	}
+}
+
+size_t WorkStealingPool::thread_count() const
+{
+	return _thread_count;
+}
+
+void WorkStealingPool::run(size_t count, std::function<void(size_t)> const& task)
+{
+	// deal out contiguous runs of tasks, so neighbouring tasks tend to run on the same thread
+	for (size_t i = 0; i < _thread_count; i++)
+	{
+		for (size_t t = i * count / _thread_count; t < (i + 1) * count / _thread_count; t++)
+		{
+			_queues[i]->tasks.push_back(t);
+		}
+	}
+
+	// the calling thread does its share too
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < _thread_count; i++)
+	{
+		threads.emplace_back(&WorkStealingPool::work, this, i, std::cref(task));
+	}
+	work(0, task);
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void WorkStealingPool::work(size_t n, std::function<void(size_t)> const& task)
+{
+	size_t t;
+	while (next_task(n, t))
+	{
+		task(t);
+	}
+}
+
+bool WorkStealingPool::next_task(size_t n, size_t& task)
+{
+	{
+		Queue& own = *_queues[n];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = own.tasks.back();
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	// no tasks are added once the pool is running, so when every queue is empty the work is done
+	for (size_t i = 1; i < _thread_count; i++)
+	{
+		Queue& victim = *_queues[(n + i) % _thread_count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
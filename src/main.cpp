@@ -2,10 +2,115 @@
 #include "Trint.h"
 #include "Memory.h"
 #include "CPU.h"
+#include "AotCompiler.h"
+#include "BatchRunner.h"
+#include "ForkServer.h"
 #include "test.h"
 #include <fstream>
 #include <ciso646>
 #include <string>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+// true for three septavingt digits - an address, as in assembly without the $
+bool is_septavingt_address(std::string const& text)
+{
+    return text.size() == 3 and text.find_first_not_of("MLKJIHGFEDCBA0abcdefghijklm") == std::string::npos;
+}
+
+// true if the argument after i is a whole number from min to max, which is put in value
+bool read_number_arg(int argc, char** argv, int i, long long min, long long max, long long& value)
+{
+    if (i + 1 == argc)
+    {
+        return false;
+    }
+    std::string text(argv[i + 1]);
+    size_t end = 0;
+    try
+    {
+        value = std::stoll(text, &end);
+    }
+    catch (std::logic_error const&)
+    {
+        // std::invalid_argument or std::out_of_range
+        return false;
+    }
+    return end == text.size() and value >= min and value <= max;
+}
+
+// run every job in a batch manifest, reporting any that fail
+int run_batch(std::string const& manifest_filename, size_t thread_count, bool jit_on, bool stats_on)
+{
+    BatchRunner batch(manifest_filename);
+    if (jit_on)
+    {
+        batch.enable_jit();
+    }
+    auto start = std::chrono::steady_clock::now();
+    size_t failed = batch.run(thread_count);
+    auto end = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        BatchRunner::Job const& job = batch.job(i);
+        BatchRunner::Result const& result = batch.result(i);
+        if (!result.ok)
+        {
+            std::cerr << "Job " << i + 1 << " (" << job.disk_filenames[0] << ") failed: " << result.error;
+        }
+        else if (stats_on)
+        {
+            std::cerr << "Job " << i + 1 << " (" << job.disk_filenames[0] << "): " << result.us << " us ("
+                << result.instructions << " instructions)\n";
+        }
+    }
+    auto run_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    std::cout << "Ran " << batch.size() << " jobs in " << run_ms << " ms, " << failed << " failed.\n";
+    return failed == 0 ? 0 : 1;
+}
+
+// run the booted computer to the fork server's marker, then fork a clone for each job in the manifest
+int run_fork_server(CPU& cpu, std::string const& manifest_filename, std::string const& fork_address,
+    size_t thread_count, bool stats_on)
+{
+    ForkServer server(cpu, manifest_filename);
+    auto start = std::chrono::steady_clock::now();
+    if (fork_address.empty())
+    {
+        server.run_to_marker();
+    }
+    else if (!server.run_to_marker(Tryte(fork_address)))
+    {
+        std::cout << "The computer stopped before reaching " << fork_address << ". Aborting.\n";
+        return 1;
+    }
+    auto marker = std::chrono::steady_clock::now();
+    size_t failed = server.run(thread_count);
+    auto end = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < server.size(); i++)
+    {
+        ForkServer::Result const& result = server.result(i);
+        if (!result.ok)
+        {
+            std::cerr << "Clone " << i + 1 << " (" << server.clone(i).output_filename << ") failed.\n";
+        }
+        else if (stats_on)
+        {
+            std::cerr << "Clone " << i + 1 << " (" << server.clone(i).output_filename << "): " << result.us << " us\n";
+        }
+    }
+    auto marker_ms = std::chrono::duration_cast<std::chrono::milliseconds>(marker - start).count();
+    auto run_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - marker).count();
+    std::cout << "Reached the marker in " << marker_ms << " ms (" << cpu.clock() << " instructions), then ran "
+        << server.size() << " clones in " << run_ms << " ms, " << failed << " failed.\n";
+    return failed == 0 ? 0 : 1;
+}
 
 int main(int argc, char** argv)
 {
@@ -13,41 +118,302 @@ int main(int argc, char** argv)
     std::vector<std::fstream*> disks;
     std::vector<std::string> disk_filenames;
     bool debug_mode_on = false;
+    bool stats_on = false;
+    bool async_input_on = false;
+    bool jit_on = false;
+    bool profile_on = false;
+    int16_t input_priority = 0;
+    std::string aot_filename;
+    std::string map_filename;
+    std::string batch_filename;
+    size_t thread_count = 0;
+    size_t core_count = 1;
+    std::string save_snapshot_filename;
+    std::string restore_snapshot_filename;
+    std::string fork_filename;
+    std::string fork_address;
+    std::string record_filename;
+    std::string replay_filename;
+    size_t output_buffer_size = Console::default_buffer_size;
+    unsigned frame_rate = Display::default_frame_rate;
+    long long number = 0;
 
-    if (argc == 1)
-    {
-        std::cout << "No disk names detected. Aborting.\n";
-    }
-    else if (argv[1] == std::string("-debug"))
+    for (int i = 1; i < argc; i++)
     {
-        debug_mode_on = true;
-        if (argc == 2)
+        std::string arg(argv[i]);
+        if (arg == "-debug")
         {
-            std::cout << "No disk names detected. Aborting.\n";
+            debug_mode_on = true;
         }
-        else
+        else if (arg == "-jit")
+        {
+            jit_on = true;
+        }
+        else if (arg == "--profile")
+        {
+            profile_on = true;
+        }
+        else if (arg == "--map")
+        {
+            // source map for --profile (default: the boot disk's name with .map in place of .tri)
+            if (i + 1 == argc)
+            {
+                std::cout << "--map needs a source map file name. Aborting.\n";
+                return 1;
+            }
+            map_filename = argv[i + 1];
+            i++;
+        }
+        else if (arg == "--batch")
+        {
+            // run every job in a manifest, rather than a single program
+            if (i + 1 == argc)
+            {
+                std::cout << "--batch needs a manifest file name. Aborting.\n";
+                return 1;
+            }
+            batch_filename = argv[i + 1];
+            i++;
+        }
+        else if (arg == "--threads")
+        {
+            if (!read_number_arg(argc, argv, i, 1, std::numeric_limits<int>::max(), number))
+            {
+                std::cout << "--threads needs a number of threads. Aborting.\n";
+                return 1;
+            }
+            thread_count = number;
+            i++;
+        }
+        else if (arg == "--cores")
+        {
+            // run several cores over the same memory, each on its own thread
+            if (!read_number_arg(argc, argv, i, 1, CPU::max_cores, number))
+            {
+                std::cout << "--cores needs a number of cores (1 to " << CPU::max_cores << "). Aborting.\n";
+                return 1;
+            }
+            core_count = number;
+            i++;
+        }
+        else if (arg == "--save-snapshot" or arg == "--restore-snapshot")
+        {
+            // save the computer's state when it stops, or start from a saved state rather than booting
+            if (i + 1 == argc)
+            {
+                std::cout << arg << " needs a snapshot file name. Aborting.\n";
+                return 1;
+            }
+            (arg == "--save-snapshot" ? save_snapshot_filename : restore_snapshot_filename) = argv[i + 1];
+            i++;
+        }
+        else if (arg == "--fork-server" or arg == "--fork-at")
+        {
+            // boot once, then run clones of the computer from a marker (the first HALT, or an address)
+            if (i + 1 == argc or (arg == "--fork-at" and !is_septavingt_address(argv[i + 1])))
+            {
+                std::cout << arg << (arg == "--fork-server" ? " needs a manifest file name" : " needs an address (3 septavingt digits)")
+                    << ". Aborting.\n";
+                return 1;
+            }
+            (arg == "--fork-server" ? fork_filename : fork_address) = argv[i + 1];
+            i++;
+        }
+        else if (arg == "--record" or arg == "--replay")
+        {
+            // log everything the program takes in from outside, or feed in a log recorded earlier
+            if (i + 1 == argc)
+            {
+                std::cout << arg << " needs a replay log file name. Aborting.\n";
+                return 1;
+            }
+            (arg == "--record" ? record_filename : replay_filename) = argv[i + 1];
+            i++;
+        }
+        else if (arg == "--output-buffer")
+        {
+            // bytes of console output to hold before writing it out
+            if (!read_number_arg(argc, argv, i, 0, std::numeric_limits<int>::max(), number))
+            {
+                std::cout << "--output-buffer needs a size in bytes (0 for no buffering). Aborting.\n";
+                return 1;
+            }
+            output_buffer_size = number;
+            i++;
+        }
+        else if (arg == "--fps")
         {
-            size_t no_of_files = argc - 1;
-            for (size_t i = 1; i < no_of_files; i++)
+            // frames drawn per second in graphics mode
+            if (!read_number_arg(argc, argv, i, 0, std::numeric_limits<int>::max(), number))
             {
-                std::string disk_name(argv[i + 1]);
-                disk_filenames.push_back(disk_name);
+                std::cout << "--fps needs a frame rate (0 to draw only when the computer halts). Aborting.\n";
+                return 1;
             }
+            frame_rate = number;
+            i++;
+        }
+        else if (arg == "--stats")
+        {
+            stats_on = true;
+        }
+        else if (arg == "--aot")
+        {
+            // compile the boot disk's program to C++, rather than running it
+            if (i + 1 == argc)
+            {
+                std::cout << "--aot needs an output file name. Aborting.\n";
+                return 1;
+            }
+            aot_filename = argv[i + 1];
+            i++;
+        }
+        else if (arg == "--input-interrupt")
+        {
+            // read input in the background, raising an interrupt of the given priority when it arrives
+            if (!read_number_arg(argc, argv, i, -13, 13, number))
+            {
+                std::cout << "--input-interrupt needs a priority (-13 to 13). Aborting.\n";
+                return 1;
+            }
+            async_input_on = true;
+            input_priority = number;
+            i++;
+        }
+        else
+        {
+            disk_filenames.push_back(arg);
         }
     }
-    else
+    if (async_input_on and debug_mode_on)
+    {
+        std::cout << "--input-interrupt can't be used with -debug, which reads commands from the console. Aborting.\n";
+        return 1;
+    }
+    bool replay_on = !record_filename.empty() or !replay_filename.empty();
+    if (!record_filename.empty() and !replay_filename.empty())
+    {
+        std::cout << "--record and --replay can't be used together. Aborting.\n";
+        return 1;
+    }
+    if (replay_on and (core_count > 1 or debug_mode_on or !batch_filename.empty() or !fork_filename.empty()))
     {
-        size_t no_of_files = argc;
-        for (size_t i = 1; i < no_of_files; i++)
+        std::cout << "--record and --replay follow a single core, so can't be used with --cores, -debug, --batch or --fork-server. Aborting.\n";
+        return 1;
+    }
+    if (!replay_filename.empty() and async_input_on)
+    {
+        std::cout << "--replay takes input and interrupts from the log, so can't be used with --input-interrupt. Aborting.\n";
+        return 1;
+    }
+    if (!batch_filename.empty())
+    {
+        if (debug_mode_on or async_input_on or profile_on or !aot_filename.empty() or !disk_filenames.empty() or core_count > 1)
         {
-            std::string disk_name(argv[i]);
-            disk_filenames.push_back(disk_name);
-        }  
+            std::cout << "--batch takes its disks from the manifest, and can only be used with -jit, --threads and --stats. Aborting.\n";
+            return 1;
+        }
+        return run_batch(batch_filename, thread_count, jit_on, stats_on);
+    }
+    if (core_count > 1 and (!save_snapshot_filename.empty() or !restore_snapshot_filename.empty()))
+    {
+        std::cout << "Snapshots hold a single core, so can't be used with --cores. Aborting.\n";
+        return 1;
+    }
+    if (!fork_filename.empty() and (core_count > 1 or async_input_on or debug_mode_on or profile_on
+        or !aot_filename.empty() or !save_snapshot_filename.empty()))
+    {
+        std::cout << "--fork-server can only be used with -jit, --fork-at, --threads, --restore-snapshot and --stats. Aborting.\n";
+        return 1;
+    }
+    if (!fork_address.empty() and fork_filename.empty())
+    {
+        std::cout << "--fork-at is for --fork-server. Aborting.\n";
+        return 1;
+    }
+    if (core_count > 1 and debug_mode_on)
+    {
+        std::cout << "--cores can't be used with -debug, which steps a single core. Aborting.\n";
+        return 1;
+    }
+    if (disk_filenames.empty())
+    {
+        std::cout << "No disk names detected. Aborting.\n";
+        return 1;
     }
 
+    // boot time covers opening every disk as well as copying the boot disk into memory
+    auto boot_start = std::chrono::steady_clock::now();
     CPU cpu(memory, disk_filenames);
+    cpu.set_console_buffer_size(output_buffer_size);
+    cpu.set_frame_rate(frame_rate);
+    size_t boot_size = 0;
+    if (restore_snapshot_filename.empty())
+    {
+        boot_size = cpu.boot();
+    }
+    else
+    {
+        cpu.restore_snapshot(restore_snapshot_filename);
+    }
+    if (!aot_filename.empty())
+    {
+        AotCompiler compiler(cpu);
+        compiler.compile();
+        std::ofstream aot_file(aot_filename);
+        compiler.write(aot_file);
+        if (!aot_file)
+        {
+            std::cout << "Could not write " << aot_filename << ". Aborting.\n";
+            return 1;
+        }
+        std::cout << "Compiled " << compiler.size() << " blocks from " << disk_filenames[0] << " to " << aot_filename << ".\n";
+        return 0;
+    }
+    if (async_input_on)
+    {
+        cpu.enable_async_input(input_priority);
+    }
+    if (!record_filename.empty())
+    {
+        cpu.record_input(record_filename);
+    }
+    else if (!replay_filename.empty())
+    {
+        cpu.replay_input(replay_filename);
+    }
+    if (jit_on)
+    {
+        cpu.enable_jit();
+    }
+    // the other cores start at address 0 too, once the boot core has loaded the program
+    std::vector<std::unique_ptr<CPU>> cores;
+    for (size_t core = 1; core < core_count; core++)
+    {
+        cores.push_back(std::make_unique<CPU>(cpu, core));
+        cores.back()->boot();
+        if (jit_on)
+        {
+            cores.back()->enable_jit();
+        }
+    }
+    if (profile_on)
+    {
+        if (map_filename.empty())
+        {
+            std::string map_guess = disk_filenames[0].substr(0, disk_filenames[0].rfind('.')) + ".map";
+            if (std::ifstream(map_guess))
+            {
+                map_filename = map_guess;
+            }
+        }
+        cpu.enable_profiler(std::cerr, map_filename);
+    }
+    auto boot_end = std::chrono::steady_clock::now();
+    if (!fork_filename.empty())
+    {
+        return run_fork_server(cpu, fork_filename, fork_address, thread_count, stats_on);
+    }
 
-    cpu.boot();
     if (debug_mode_on)
     {
         std::cout << "Starting program.\n";
@@ -76,7 +442,50 @@ int main(int argc, char** argv)
     }
     else
     {
+        std::vector<std::thread> core_threads;
+        for (auto& core : cores)
+        {
+            core_threads.emplace_back(&CPU::run, core.get());
+        }
         cpu.run();
+        for (std::thread& core_thread : core_threads)
+        {
+            core_thread.join();
+        }
+    }
+    if (!save_snapshot_filename.empty())
+    {
+        cpu.save_snapshot(save_snapshot_filename);
+    }
+    if (cpu.replay_unfinished())
+    {
+        std::cerr << "The program stopped before the end of " << replay_filename << ".\n";
+    }
+
+    if (stats_on)
+    {
+        auto run_end = std::chrono::steady_clock::now();
+        auto boot_us = std::chrono::duration_cast<std::chrono::microseconds>(boot_end - boot_start).count();
+        auto run_us = std::chrono::duration_cast<std::chrono::microseconds>(run_end - boot_end).count();
+        if (restore_snapshot_filename.empty())
+        {
+            std::cerr << "Boot: " << boot_us << " us (" << boot_size << " Trytes from " << disk_filenames[0] << ")\n";
+        }
+        else
+        {
+            std::cerr << "Boot: " << boot_us << " us (restored " << restore_snapshot_filename << ")\n";
+        }
+        size_t instructions = cpu.clock();
+        for (auto& core : cores)
+        {
+            instructions += core->clock();
+        }
+        std::cerr << "Run: " << run_us << " us (" << instructions << " instructions";
+        if (core_count > 1)
+        {
+            std::cerr << " on " << core_count << " cores";
+        }
+        std::cerr << ")\n";
     }
     
     
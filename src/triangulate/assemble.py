@@ -89,6 +89,10 @@ def assemble_instr(statement):
         "SETINT": handle_instr.SETINT,
         "HALT": handle_instr.HALT,
         "WAIT": handle_instr.WAIT,
+        "CORE": handle_instr.CORE,
+        "CAS": handle_instr.CAS,
+        "FADD": handle_instr.FADD,
+        "FENCE": handle_instr.FENCE,
         "CALL": handle_instr.CALL,
         "STRWRT": handle_instr.STRWRT,
         "STRPNT": handle_instr.STRPNT}
@@ -104,17 +108,23 @@ def assemble_instr(statement):
         return [output_trytes] + [len(output_trytes)]
 
 def assemble_function(function_body, function_name):
+    """
+    Assemble each statement of a function. Statements come out as [trytes, line_number, length],
+    so the linker can work out where each source line ends up.
+    """
     assembled_fn = []
     # assemble function
     for statement in function_body:
-        assembled_fn.append(assemble_instr(statement))
+        assembled_statement = assemble_instr(statement)
+        assembled_fn.append([assembled_statement[0], statement[-1], assembled_statement[-1]])
         
     # append "0jM" to each internal function - it's a pop and jump
+    # (it has no source line of its own, so it is given None)
     if function_name != "main":
-        assembled_fn.append([["0jM"], 1])
+        assembled_fn.append([["0jM"], None, 1])
     else:
         # if we hit the end of main, we have to halt
-        assembled_fn.append([["000"], 1])
+        assembled_fn.append([["000"], None, 1])
 
     return assembled_fn
 
@@ -210,6 +210,10 @@ def PJP(statement):
 def CHK(statement):
     return ["0c0"]
 
+def FENCE(statement):
+    arg_number_check(statement, 0)
+    return ["aF0"]
+
 # 1 argument
 
 def PRI(statement):
@@ -322,6 +326,14 @@ def WHERE(statement):
     else:
         print_error(statement[-1], "Argument {} in {} statement must be a valid Tryte register.".format(1, statement[0]))
 
+def CORE(statement):
+    arg_number_check(statement, 1)
+    if arg_is_tryte_reg(statement[1]):
+        opcode = tryte_reg_to_opcode("0d", statement[1])
+        return [opcode]
+    else:
+        print_error(statement[-1], "Argument {} in {} statement must be a valid Tryte register.".format(1, statement[0]))
+
 def SHOW(statement):
     arg_number_check(statement, 1)
     if arg_is_tryte_reg(statement[1]):
@@ -532,6 +544,19 @@ def WRITE(statement):
     
     return [opcode, addr]
 
+def FADD(statement):
+    arg_number_check(statement, 2)
+    if arg_is_tryte_reg(statement[1]):
+        opcode = tryte_reg_to_opcode("ae", statement[1])
+    else:
+        print_error(statement[-1], "Argument {} in {} statement must be a valid Tryte register.".format(1, statement[0]))
+    if arg_is_addr(statement[2]):
+        addr = statement[2][1:]
+    else:
+        print_error(statement[-1], "Argument {} in {} statement must be a valid address.".format(2, statement[0]))
+
+    return [opcode, addr]
+
 def SET(statement):
     arg_number_check(statement, 2)
     if arg_is_tryte_reg(statement[1]):
@@ -917,6 +942,17 @@ def SWAP(statement):
         print_error(statement[-1], "Argument {} in {} statement must be a valid register.".format(1, statement[0]))
 
 # 3 arguments
+def CAS(statement):
+    arg_number_check(statement, 3)
+    for i in [1, 2]:
+        if not arg_is_tryte_reg(statement[i]):
+            print_error(statement[-1], "Argument {} in {} statement must be a valid Tryte register.".format(i, statement[0]))
+    if arg_is_addr(statement[3]):
+        addr = statement[3][1:]
+    else:
+        print_error(statement[-1], "Argument {} in {} statement must be a valid address.".format(3, statement[0]))
+    return ["d" + tryte_registers[statement[1]] + tryte_registers[statement[2]], addr]
+
 def LOAD(statement):
     arg_number_check(statement, 3)
     if arg_is_addr(statement[1]):
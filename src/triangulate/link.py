@@ -22,6 +22,26 @@ def build_fn_start_dict(assembled_code_dict):
             pointer += function_length(fn_body)
     return fn_start_dict
 
+def build_source_map(assembled_code_dict):
+    """
+    Work out where each function and source line ends up in the linked output. Returns a list of
+    functions, as [name, start, end], and a list of lines, as [line_number, start, end] - end is
+    one past the last address.
+    """
+    fn_start_dict = build_fn_start_dict(assembled_code_dict)
+    functions = []
+    lines = []
+    for fn_name, fn_start in fn_start_dict.items():
+        pointer = fn_start
+        for assembled_statement in assembled_code_dict[fn_name]:
+            length = assembled_statement[-1]
+            line_number = assembled_statement[1]
+            if length > 0 and line_number is not None:
+                lines.append([line_number, pointer, pointer + length])
+            pointer += length
+        functions.append([fn_name, fn_start, pointer])
+    return functions, lines
+
 def handle_function_calls(assembled_code_dict, fn_start_dict):
     """
     Loop through function bodies, find all CALL $func placeholders and replace them with
@@ -1,6 +1,8 @@
 import triangulate
 import handle_instr
 import assemble
+import link
+import parse
 
 test_tryte_registers = {"A0": "M", "A1": "L", "A2": "K", "B0": "J", 
     "B1": "I", "B2": "H", "C0": "G", "C1": "F", "C2": "E", "D0": "D", 
@@ -46,6 +48,11 @@ def test_WAIT():
     test_output = assemble.assemble_instr(['WAIT', 11])
     assert(test_output == expected_output)
 
+def test_FENCE():
+    expected_output = [["aF0"], 1]
+    test_output = assemble.assemble_instr(['FENCE', 11])
+    assert(test_output == expected_output)
+
 def test_CCMP():
     expected_output = [["0a0"], 1]
     test_output = assemble.assemble_instr(['CCMP', 11])
@@ -142,6 +149,12 @@ def test_WHERE():
         test_output = assemble.assemble_instr(["WHERE", tryte, 7])
         assert(test_output == expected_output)
 
+def test_CORE():
+    for tryte in test_tryte_registers:
+        expected_output = [["0d" + test_tryte_registers[tryte]], 1]
+        test_output = assemble.assemble_instr(["CORE", tryte, 7])
+        assert(test_output == expected_output)
+
 def test_SHOW():
     for tryte in test_tryte_registers:
         expected_output = [["aA" + test_tryte_registers[tryte]], 1]
@@ -303,6 +316,12 @@ def test_READ():
         test_output = assemble.assemble_instr(["READ", "$DDD", tfloat, 7])
         assert(test_output == expected_output)
 
+def test_FADD():
+    for tryte in test_tryte_registers:
+        expected_output = [["ae" + test_tryte_registers[tryte], "DDD"], 2]
+        test_output = assemble.assemble_instr(["FADD", tryte, "$DDD", 5])
+        assert(test_output == expected_output)
+
 def test_WRITE():
     for tryte in test_tryte_registers:
         expected_output = [["aB" + test_tryte_registers[tryte], "DDD"], 2]
@@ -693,6 +712,13 @@ def test_SWAP_trints():
             assert(test_output == expected_output)
 
 # 3 arguments
+def test_CAS():
+    for tryte1 in test_tryte_registers:
+        for tryte2 in test_tryte_registers:
+            expected_output = [["d" + test_tryte_registers[tryte1] + test_tryte_registers[tryte2], "eee"], 2]
+            test_output = assemble.assemble_instr(["CAS", tryte1, tryte2, "$eee", 26])
+            assert(test_output == expected_output)
+
 def test_LOAD():
     expected_output = [["aM0", "DDD", "00a", "eee"], 4]
     test_output = assemble.assemble_instr(["LOAD", "$DDD", 1, "$eee", 26])
@@ -712,4 +738,20 @@ def test_SAVE():
 def test_FILL():
     expected_output = [["af0", "DDD", "0b0", "0CC"], 4]
     test_output = assemble.assemble_instr(["FILL", "$DDD", 54, -84, 26])
-    assert(test_output == expected_output)
\ No newline at end of file
+    assert(test_output == expected_output)
+
+# source map
+def test_build_source_map():
+    code = ["main:\n", "    SET A0, 1\n", "    !loop\n", "    CALL inc\n", "    JP loop\n", "end main\n",
+        "inc:\n", "    INC A\n", "end inc\n"]
+    assembled_code = assemble.assemble_code(parse.parse_code(code, False), False)
+    functions, lines = link.build_source_map(assembled_code)
+    # main: SET (2), CALL (2), JP (2), HALT (1); inc: INC (1), PJP (1)
+    assert(functions == [["main", 0, 7], ["inc", 7, 9]])
+    assert(lines == [[2, 0, 2], [4, 2, 4], [5, 4, 6], [8, 7, 8]])
+
+def test_source_line():
+    input_files = [["first.tas", 10], ["second.tas", 5]]
+    assert(triangulate.source_line(4, input_files) == ("first.tas", 4))
+    assert(triangulate.source_line(10, input_files) == ("first.tas", 10))
+    assert(triangulate.source_line(11, input_files) == ("second.tas", 1))
@@ -1,8 +1,9 @@
 #!/usr/bin/env python3
+import os
 import sys
 from parse import parse_code
 from assemble import assemble_code
-from link import link_code
+from link import link_code, build_source_map
 
 def handle_inputs():
     """
@@ -58,19 +59,44 @@ def handle_inputs():
 def triangulate(input_code, debug_mode):
     """
     Main assembler function. Parses, assembles and links the input text file to a string of Trytes,
-    ready for the computer to read.
+    ready for the computer to read. Also returns the source map (see link.build_source_map).
     """
     if debug_mode:
         print("Input code:")
         print(input_code)
     parsed_code = parse_code(input_code, debug_mode)
     assembled_code = assemble_code(parsed_code, debug_mode)
+    source_map = build_source_map(assembled_code)
     linked_code = link_code(assembled_code, debug_mode)
     assembly_string = ' '.join(linked_code)
     if debug_mode:
         print("Output assembly:")
         print(assembly_string)
-    return assembly_string
+    return assembly_string, source_map
+
+def source_line(line_number, input_files):
+    """
+    Turn a line number in the joined input into a file name and a line number in that file.
+    input_files is a list of [file_name, number_of_lines].
+    """
+    for file_name, file_lines in input_files:
+        if line_number <= file_lines:
+            return file_name, line_number
+        line_number -= file_lines
+    return input_files[-1][0], line_number + input_files[-1][1]
+
+def write_source_map(map_filename, source_map, input_files):
+    """
+    Write the source map next to the output, for the computer's profiler. One entry per line:
+    fn NAME START END, or line FILE LINE START END (addresses in decimal, END one past the last).
+    """
+    functions, lines = source_map
+    with open(map_filename, 'w') as writer:
+        for fn_name, start, end in functions:
+            writer.write("fn {} {} {}\n".format(fn_name, start, end))
+        for line_number, start, end in lines:
+            file_name, file_line = source_line(line_number, input_files)
+            writer.write("line {} {} {} {}\n".format(file_name, file_line, start, end))
 
 if __name__ == "__main__":
     filenames, debug_mode = handle_inputs()
@@ -78,12 +104,18 @@ if __name__ == "__main__":
     output_filename = filenames[-1]
 
     input_code = []
+    input_files = []
     for input_filename in input_filenames:
         with open(input_filename) as f:
-            input_code += f.readlines()
+            input_lines = f.readlines()
+            input_code += input_lines
+            input_files.append([input_filename, len(input_lines)])
     
-    output_code = triangulate(input_code, debug_mode)
+    output_code, source_map = triangulate(input_code, debug_mode)
 
     # then write assembly_string to output file
     with open(output_filename, 'w') as writer:
-        writer.write(output_code)
\ No newline at end of file
+        writer.write(output_code)
+
+    # and the source map alongside it (program.tri -> program.map)
+    write_source_map(os.path.splitext(output_filename)[0] + ".map", source_map, input_files)
\ No newline at end of file
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""
+Convert disks between the text format (.tri files of septavingt Trytes, as made by the assembler)
+and the binary format the VM memory-maps (.trd files).
+
+Binary disks start with the 8 byte header b"TRIDISK\\x01", followed by 19,683 Trytes stored as
+signed 16 bit integers. The VM uses them in its host's byte order (little-endian on every supported
+target), so this writes and reads them little-endian.
+
+Usage:
+python3 tools/convert_disk.py input.tri -o output.trd
+python3 tools/convert_disk.py input.trd -o output.tri
+"""
+import struct
+import sys
+
+BINARY_HEADER = b"TRIDISK\x01"
+DISK_SIZE = 19683
+SEPTAVINGT_CHARS = "MLKJIHGFEDCBA0abcdefghijklm"
+TERNARY_CHARS = "-0+"
+
+
+def tryte_to_value(tryte):
+    """
+    Convert a Tryte string (3 septavingt digits or 9 trits) to its integer value.
+    """
+    if len(tryte) == 3:
+        digits, base, chars = tryte, 27, SEPTAVINGT_CHARS
+    elif len(tryte) == 9:
+        digits, base, chars = tryte, 3, TERNARY_CHARS
+    else:
+        raise ValueError("'{}' is not a Tryte.".format(tryte))
+    offset = (len(chars) - 1) // 2
+    value = 0
+    for digit in digits:
+        index = chars.find(digit)
+        if index < 0:
+            raise ValueError("'{}' is not a Tryte.".format(tryte))
+        value = base * value + index - offset
+    return value
+
+
+def value_to_tryte(value):
+    """
+    Convert an integer between -9841 and 9841 to a 3 digit septavingt string.
+    """
+    digits = ""
+    for _ in range(3):
+        digit = ((value + 13) % 27) - 13
+        digits = SEPTAVINGT_CHARS[digit + 13] + digits
+        value = (value - digit) // 27
+    return digits
+
+
+def text_to_binary(text):
+    """
+    Convert the contents of a text disk to a full size binary disk image.
+    """
+    values = [tryte_to_value(tryte) for tryte in text.split()]
+    if len(values) > DISK_SIZE:
+        raise ValueError("Disk has {} Trytes, but only {} fit on a disk.".format(len(values), DISK_SIZE))
+    values += [0] * (DISK_SIZE - len(values))
+    return BINARY_HEADER + struct.pack("<{}h".format(DISK_SIZE), *values)
+
+
+def binary_to_text(data):
+    """
+    Convert a binary disk image to a text disk. Trailing zero Trytes are left off.
+    """
+    if data[:len(BINARY_HEADER)] != BINARY_HEADER:
+        raise ValueError("Not a binary disk.")
+    body = data[len(BINARY_HEADER):]
+    # short images (as written by other tools) are padded with zeroes by the VM too
+    body = body[:2 * DISK_SIZE]
+    values = list(struct.unpack("<{}h".format(len(body) // 2), body[:len(body) - len(body) % 2]))
+    while values and values[-1] == 0:
+        values.pop()
+    return "".join(value_to_tryte(value) + " " for value in values)
+
+
+def main():
+    input_args = sys.argv[1:]
+    if len(input_args) != 3 or input_args[1] != "-o":
+        print(__doc__)
+        sys.exit(1)
+    in_file, out_file = input_args[0], input_args[2]
+
+    with open(in_file, "rb") as f:
+        data = f.read()
+    try:
+        if data[:len(BINARY_HEADER)] == BINARY_HEADER:
+            with open(out_file, "w") as f:
+                f.write(binary_to_text(data))
+        else:
+            with open(out_file, "wb") as f:
+                f.write(text_to_binary(data.decode("ascii")))
+    except ValueError as e:
+        sys.exit("convert_disk: fatal error: {}".format(e))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,33 @@
+#!/bin/bash
+# usage: [COMPUTER=path/to/ternary_computer] tools/run_benchmarks.sh [runs] program.tri...
+# e.g. tools/run_benchmarks.sh test/tern/loop.tri test/tern/muldiv.tri test/tern/div_zero_test.tri
+# Runs each program with the release build (or the computer given in COMPUTER) and prints the
+# fastest wall time in ms. To compare against an older version, build it in a worktree (without
+# -Werror, as newer compilers warn about older code):
+#   git worktree add /tmp/baseline <commit> && make -C /tmp/baseline CFLAGS="-std=c++17 -pthread"
+#   COMPUTER=/tmp/baseline/build/release/ternary_computer tools/run_benchmarks.sh test/tern/div_zero_test.tri
+computer=${COMPUTER:-./build/release/ternary_computer}
+if [[ ! -x "$computer" ]]; then
+echo "$computer isn't an executable - build it first (make).";
+exit 1;
+fi
+runs=5
+if [[ "$1" =~ ^[0-9]+$ ]]; then
+runs=$1;
+shift;
+fi
+for f in "$@";
+do
+best=0;
+for ((i = 0; i < runs; i++));
+do
+start=$(date +%s%N);
+"$computer" "$f" < /dev/null > /dev/null;
+end=$(date +%s%N);
+elapsed=$(( (end - start) / 1000000 ));
+if (( i == 0 || elapsed < best )); then
+best=$elapsed;
+fi
+done
+echo "$(basename -- "$f"): $best ms";
+done